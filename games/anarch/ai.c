@@ -30,9 +30,12 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //Typedefs
+RvR_pool_type(AI_ent,ai_pool_ent);
 //-------------------------------------
 
 //Function prototypes
+RvR_pool_function_prototype(AI_ent,ai_pool_ent,static inline);
+
 static void mutant_idle(AI_ent *e);
 static void shotgun(AI_ent *e);
 static void shotgun_open(AI_ent *e);
@@ -187,7 +190,7 @@ static const AI_info ai_entinfo[AI_TYPE_MAX] = {
   },
 };
 
-static AI_ent *ai_ent_pool = NULL;
+static ai_pool_ent ai_ent_pool = {0};
 static AI_ent *ents = NULL;
 //-------------------------------------
 
@@ -316,24 +319,18 @@ AI_ent *ai_index_try(AI_index in)
 
 AI_ent *ai_ent_new()
 {
-   if(ai_ent_pool==NULL)
-   {
-      AI_ent *ne = RvR_malloc(sizeof(*ne)*256);
-      memset(ne,0,sizeof(*ne)*256);
-      
-      for(int i = 0;i<256-1;i++)
-         ne[i].next = &ne[i+1];
-      ai_ent_pool = &ne[0];
-   }
+   int32_t capacity = ai_ent_pool.capacity;
+   int32_t index = ai_pool_ent_alloc(&ai_ent_pool);
 
-   AI_ent *n = ai_ent_pool;
-   ai_ent_pool = n->next;
-   n->next = NULL;
-   n->prev_next = NULL;
+   //Generations of new slots start at 0
+   for(int32_t i = capacity;i<ai_ent_pool.capacity;i++)
+      ai_pool_ent_get(&ai_ent_pool,i)->generation = 0;
 
+   AI_ent *n = ai_pool_ent_get(&ai_ent_pool,index);
    uint32_t gen = n->generation;
    memset(n,0,sizeof(*n));
    n->generation = gen;
+   n->pool_index = index;
 
    return n;
 }
@@ -365,30 +362,18 @@ void ai_ent_free(AI_ent *e)
    if(e->next!=NULL)
       e->next->prev_next = e->prev_next;
 
-   e->next = ai_ent_pool;
-   ai_ent_pool = e;
+   ai_pool_ent_free(&ai_ent_pool,e->pool_index);
 }
 
+//Entities still alive never had their generation bumped by
+//ai_ent_remove(), bump all of them so old AI_index values stay invalid
 void ai_ent_clear()
 {
-   AI_ent *e = ents;
-   while(e!=NULL)
-   {
-      AI_ent *next = e->next;
+   for(int32_t i = 0;i<ai_ent_pool.capacity;i++)
+      ai_pool_ent_get(&ai_ent_pool,i)->generation++;
 
-      ai_ent_free(e);
-      e = next;
-   }
    ents = NULL;
-
-   //Reset pool
-   AI_ent *pool = ai_ent_pool;
-   while(pool!=NULL)
-   {
-      AI_ent *next = pool->next;
-      memset(pool,0,sizeof(*pool));
-      pool = next;
-   }
+   ai_pool_ent_reset(&ai_ent_pool);
 }
 
 AI_ent *ai_ents()
@@ -620,4 +605,6 @@ static void add_collider(AI_ent *e, RvR_vec3 pos, RvR_fix22 radius, RvR_fix22 he
    e->collider->ent = e;
    collision_add(e->collider);
 }
+
+RvR_pool_function(AI_ent,ai_pool_ent,8,static inline)
 //-------------------------------------
@@ -107,6 +107,9 @@ typedef struct
 
 struct AI_ent
 {
+   //Index in the entity pool. Comes first since the pool overwrites
+   //the start of free entries, generation has to survive that
+   int32_t pool_index;
    uint32_t generation;
 
    RvR_vec3 pos;
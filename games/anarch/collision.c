@@ -26,14 +26,17 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //Typedefs
+RvR_pool_type(Collider,collision_pool);
 //-------------------------------------
 
 //Variables
-static Collider *collider_pool = NULL;
+static collision_pool collider_pool = {0};
 static Collider *colliders = NULL;
 //-------------------------------------
 
 //Function prototypes
+RvR_pool_function_prototype(Collider,collision_pool,static inline);
+
 static void collision_intersects(Collider *a, Collider *b, RvR_fix22 *depth, RvR_vec2 *normal);
 //-------------------------------------
 
@@ -326,22 +329,10 @@ static void collision_intersects(Collider *a, Collider *b, RvR_fix22 *depth, RvR
 
 Collider *collision_new()
 {
-   if(collider_pool==NULL)
-   {
-      Collider *nc = RvR_malloc(sizeof(*nc)*256);
-      memset(nc,0,sizeof(*nc)*256);
-      
-      for(int i = 0;i<256-1;i++)
-         nc[i].next = &nc[i+1];
-      collider_pool = nc;
-   }
-
-   Collider *c = collider_pool;
-   collider_pool = c->next;
-   c->next = NULL;
-   c->prev_next = NULL;
-
+   int32_t index = collision_pool_alloc(&collider_pool);
+   Collider *c = collision_pool_get(&collider_pool,index);
    memset(c,0,sizeof(*c));
+   c->pool_index = index;
 
    return c;
 }
@@ -369,29 +360,13 @@ void collision_free(Collider *c)
    if(c->next!=NULL)
       c->next->prev_next = c->prev_next;
 
-   c->next = collider_pool;
-   collider_pool = c;
+   collision_pool_free(&collider_pool,c->pool_index);
 }
 
 void collision_clear()
 {
-   Collider *c = colliders;
-   while(c!=NULL)
-   {
-      Collider *next = c->next;
-      c->ent = NULL;
-      collision_free(c);
-      c = next;
-   }
    colliders = NULL;
-
-   Collider *pool = collider_pool;
-   while(pool!=NULL)
-   {
-      Collider *next = pool->next;
-      memset(pool,0,sizeof(*pool));
-      pool = next;
-   }
+   collision_pool_reset(&collider_pool);
 }
 
 void collision_post()
@@ -405,4 +380,6 @@ void collision_post()
       c = next;
    }
 }
+
+RvR_pool_function(Collider,collision_pool,8,static inline)
 //-------------------------------------
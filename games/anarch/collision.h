@@ -26,6 +26,7 @@ typedef struct Collider
 
    int removed;
 
+   int32_t pool_index;
    struct Collider *next;
    struct Collider **prev_next;
 }Collider;
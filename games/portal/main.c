@@ -148,6 +148,8 @@ int main(int argc, char **argv)
    map->walls[15].p2 = 11;
    map->walls[15].portal = -1;
 
+   RvR_port_map_geometry_update();
+
    RvR_vec3 pos = {0};
    pos.z = 512;
    RvR_fix22 dir = 0;
@@ -9,6 +9,13 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 */
 
 //External includes
+//The null backend needs clock_gettime(), sysconf() and pthreads,
+//defined unconditionally since RVR_BACKEND_NULL might only
+//be set in RvnicRaven.h, after the first system header
+#if !defined(_WIN32)&&!defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#endif
 //-------------------------------------
 
 //Internal includes
@@ -30,6 +37,8 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 #include "RvR_pak.c"
 #include "RvR_rw.c"
 #include "RvR_core.c"
+#include "RvR_telemetry.c"
+#include "RvR_job.c"
 #include "RvR_log.c"
 #include "RvR_rand.c"
 #include "RvR_hash.c"
@@ -38,8 +47,11 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 
 #include "RvR_config.c"
 #include "RvR_malloc.c"
+#include "RvR_frame.c"
 #include "RvR_compress.c"
 #include "RvR_draw.c"
+#include "RvR_image.c"
+#include "RvR_capture.c"
 #include "RvR_texture.c"
 
 #include "RvR_vm.c"
@@ -53,5 +65,13 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 #include "RvR_portal_map.c"
 #include "RvR_portal_draw.c"
 
+#include "RvR_pseudo3d.c"
+#include "RvR_pseudo3d_map.c"
+#include "RvR_pseudo3d_draw.c"
+
+#if RVR_BACKEND_NULL
+#include "backend/RvR_backend_null.c"
+#else
 #include "backend/RvR_backend_sdl2.c"
+#endif
 //-------------------------------------
@@ -16,10 +16,16 @@ void RvR_backend_init(const char *title, int scale);
 void RvR_backend_mouse_relative(int relative);
 void RvR_backend_mouse_show(int show);
 void RvR_backend_key_repeat(int repeat);
+void RvR_backend_present_threads(int threads);
+void RvR_backend_present_dirty(int dirty);
+void RvR_backend_present_pipelined(int pipelined);
 
 void RvR_backend_update();
 void RvR_backend_render_present();
 int RvR_backend_frametime();
+int RvR_backend_frame_delta();
+void RvR_backend_fps(int fps);
+void RvR_backend_frame_pacing(int precise);
 
 int RvR_backend_key_down(int key);
 int RvR_backend_key_pressed(int key);
@@ -35,4 +41,20 @@ uint8_t *RvR_backend_framebuffer();
 void RvR_backend_text_input_start(char *text, int max_length);
 void RvR_backend_text_input_end();
 
+//Threading primitives, only used internally by the engine
+//RvR_backend_thread_create() returns NULL if threads are not
+//available on the platform (e.g. emscripten without pthreads),
+//the caller then needs to do the work itself
+void *RvR_backend_thread_create(int (*func)(void *data), void *data);
+void  RvR_backend_thread_wait(void *thread);
+int   RvR_backend_cpu_count();
+void *RvR_backend_mutex_create();
+void  RvR_backend_mutex_lock(void *mutex);
+void  RvR_backend_mutex_unlock(void *mutex);
+void  RvR_backend_mutex_destroy(void *mutex);
+void *RvR_backend_semaphore_create(int value);
+void  RvR_backend_semaphore_wait(void *sem);
+void  RvR_backend_semaphore_post(void *sem);
+void  RvR_backend_semaphore_destroy(void *sem);
+
 #endif
@@ -0,0 +1,324 @@
+/*
+RvnicRaven retro game engine
+
+Written in 2021,2022 by Lukas Holzbeierlein (Captain4LK) email: captain4lk [at] tutanota [dot] com
+
+To the extent possible under law, the author(s) have dedicated all copyright and related and neighboring rights to this software to the public domain worldwide. This software is distributed without any warranty.
+
+You should have received a copy of the CC0 Public Domain Dedication along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+/*
+Frame capture, presented frames get copied into a ring of buffers
+and written to disk by a background thread. If the writer can't
+keep up, frames get dropped instead of stalling the game.
+
+RVR_CAPTURE_PNG writes one indexed png per frame, the path is a
+printf style format string receiving the frame number.
+
+RVR_CAPTURE_VIDEO writes all frames into a single file:
+   "RVRV", u32 width, u32 height
+   per frame:
+      u32 frame number
+      u8 palette changed, followed by 768 bytes (rgb) if set
+      u32 length, followed by length bytes of rle data
+
+The rle data encodes the frame xored with the previous one,
+a control byte c < 128 is followed by c+1 literal bytes,
+c >= 128 is followed by one byte to repeat c-125 times.
+*/
+
+//External includes
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+//-------------------------------------
+
+//Internal includes
+#include "RvnicRaven.h"
+#include "RvR_backend.h"
+//-------------------------------------
+
+//#defines
+#define CAPTURE_RLE_MAX (RVR_XRES*RVR_YRES+(RVR_XRES*RVR_YRES)/128+1)
+//-------------------------------------
+
+//Typedefs
+typedef struct
+{
+   uint32_t frame;
+   RvR_color palette[256];
+   uint8_t framebuffer[RVR_XRES*RVR_YRES];
+}capture_slot;
+//-------------------------------------
+
+//Variables
+static int capture_active = 0;
+static RvR_capture_format capture_format;
+static char capture_path[512];
+
+//Slots [capture_tail,capture_tail+capture_used) are waiting to be written
+static capture_slot *capture_slots = NULL;
+static int capture_head = 0;
+static int capture_tail = 0;
+static int capture_used = 0;
+static uint32_t capture_dropped = 0;
+
+static void *capture_thread = NULL;
+static void *capture_mutex = NULL;
+static void *capture_sem = NULL;
+static int capture_quit = 0;
+
+//Only touched by the writer
+static RvR_rw capture_rw;
+static uint8_t *capture_prev = NULL;
+static uint8_t *capture_rle = NULL;
+static RvR_color capture_prev_palette[256];
+//-------------------------------------
+
+//Function prototypes
+static int capture_writer(void *data);
+static void capture_write(capture_slot *slot);
+static uint32_t capture_rle_encode(const uint8_t *src, uint8_t *dst, int len);
+static uint32_t capture_rle_literals(const uint8_t *src, uint8_t *dst, int len);
+//-------------------------------------
+
+//Function implementations
+
+void RvR_capture_start(const char *path, RvR_capture_format format)
+{
+   RvR_capture_stop();
+
+   snprintf(capture_path,512,"%s",path);
+   capture_format = format;
+   capture_head = 0;
+   capture_tail = 0;
+   capture_used = 0;
+   capture_dropped = 0;
+   capture_quit = 0;
+
+   if(capture_slots==NULL)
+      capture_slots = RvR_malloc(sizeof(*capture_slots)*RVR_CAPTURE_BUFFERS);
+
+   if(format==RVR_CAPTURE_VIDEO)
+   {
+      RvR_rw_init_path(&capture_rw,capture_path,"wb");
+      if(!RvR_rw_valid(&capture_rw))
+         return;
+
+      if(capture_prev==NULL)
+      {
+         capture_prev = RvR_malloc(RVR_XRES*RVR_YRES);
+         capture_rle = RvR_malloc(CAPTURE_RLE_MAX);
+      }
+      memset(capture_prev,0,RVR_XRES*RVR_YRES);
+      memset(capture_prev_palette,0,sizeof(capture_prev_palette));
+
+      RvR_rw_write(&capture_rw,"RVRV",1,4);
+      RvR_rw_write_u32(&capture_rw,RVR_XRES);
+      RvR_rw_write_u32(&capture_rw,RVR_YRES);
+   }
+
+   //Without threads, frames are written synchronously
+   if(capture_mutex==NULL)
+      capture_mutex = RvR_backend_mutex_create();
+   if(capture_sem==NULL)
+      capture_sem = RvR_backend_semaphore_create(0);
+   if(capture_mutex!=NULL&&capture_sem!=NULL)
+      capture_thread = RvR_backend_thread_create(capture_writer,NULL);
+
+   capture_active = 1;
+}
+
+//Writes all frames still in the ring before returning
+void RvR_capture_stop()
+{
+   if(!capture_active)
+      return;
+
+   if(capture_thread!=NULL)
+   {
+      capture_quit = 1;
+      RvR_backend_semaphore_post(capture_sem);
+      RvR_backend_thread_wait(capture_thread);
+      capture_thread = NULL;
+   }
+
+   if(capture_format==RVR_CAPTURE_VIDEO)
+      RvR_rw_close(&capture_rw);
+
+   if(capture_dropped>0)
+      RvR_log("capture: dropped %u frames\n",capture_dropped);
+
+   capture_active = 0;
+}
+
+int RvR_capture_active()
+{
+   return capture_active;
+}
+
+uint32_t RvR_capture_dropped()
+{
+   return capture_dropped;
+}
+
+//Called by RvR_core_render_present()
+void RvR_capture_frame()
+{
+   if(!capture_active||RvR_palette()==NULL)
+      return;
+
+   RvR_backend_mutex_lock(capture_mutex);
+   int full = capture_used==RVR_CAPTURE_BUFFERS;
+   RvR_backend_mutex_unlock(capture_mutex);
+
+   if(full)
+   {
+      capture_dropped++;
+      return;
+   }
+
+   //The slot at capture_head is not visible to the writer
+   //until capture_used gets incremented
+   capture_slot *slot = &capture_slots[capture_head];
+   slot->frame = RvR_core_frame();
+   memcpy(slot->palette,RvR_palette(),sizeof(slot->palette));
+   memcpy(slot->framebuffer,RvR_core_framebuffer(),sizeof(slot->framebuffer));
+   capture_head = (capture_head+1)%RVR_CAPTURE_BUFFERS;
+
+   if(capture_thread==NULL)
+   {
+      capture_write(slot);
+      capture_tail = capture_head;
+      return;
+   }
+
+   RvR_backend_mutex_lock(capture_mutex);
+   capture_used++;
+   RvR_backend_mutex_unlock(capture_mutex);
+   RvR_backend_semaphore_post(capture_sem);
+}
+
+static int capture_writer(void *data)
+{
+   (void)data;
+
+   for(;;)
+   {
+      //One post per queued frame, the quit post always comes last
+      RvR_backend_semaphore_wait(capture_sem);
+
+      RvR_backend_mutex_lock(capture_mutex);
+      int used = capture_used;
+      RvR_backend_mutex_unlock(capture_mutex);
+
+      if(used==0)
+      {
+         if(capture_quit)
+            break;
+         continue;
+      }
+
+      capture_write(&capture_slots[capture_tail]);
+      capture_tail = (capture_tail+1)%RVR_CAPTURE_BUFFERS;
+
+      RvR_backend_mutex_lock(capture_mutex);
+      capture_used--;
+      RvR_backend_mutex_unlock(capture_mutex);
+   }
+
+   return 0;
+}
+
+static void capture_write(capture_slot *slot)
+{
+   if(capture_format==RVR_CAPTURE_PNG)
+   {
+      char path[512];
+      snprintf(path,512,capture_path,slot->frame);
+
+      RvR_rw rw;
+      RvR_rw_init_path(&rw,path,"wb");
+      if(!RvR_rw_valid(&rw))
+         return;
+      RvR_image_write_png(&rw,RVR_XRES,RVR_YRES,slot->framebuffer,slot->palette);
+      RvR_rw_close(&rw);
+
+      return;
+   }
+
+   RvR_rw_write_u32(&capture_rw,slot->frame);
+
+   int pal_changed = memcmp(slot->palette,capture_prev_palette,sizeof(capture_prev_palette))!=0;
+   RvR_rw_write_u8(&capture_rw,pal_changed);
+   if(pal_changed)
+   {
+      for(int i = 0;i<256;i++)
+      {
+         RvR_rw_write_u8(&capture_rw,slot->palette[i].r);
+         RvR_rw_write_u8(&capture_rw,slot->palette[i].g);
+         RvR_rw_write_u8(&capture_rw,slot->palette[i].b);
+      }
+      memcpy(capture_prev_palette,slot->palette,sizeof(capture_prev_palette));
+   }
+
+   //Xor with the previous frame, unchanged pixels become long runs of zeros
+   for(int i = 0;i<RVR_XRES*RVR_YRES;i++)
+   {
+      uint8_t c = slot->framebuffer[i];
+      slot->framebuffer[i]^=capture_prev[i];
+      capture_prev[i] = c;
+   }
+
+   uint32_t len = capture_rle_encode(slot->framebuffer,capture_rle,RVR_XRES*RVR_YRES);
+   RvR_rw_write_u32(&capture_rw,len);
+   RvR_rw_write(&capture_rw,capture_rle,1,len);
+}
+
+static uint32_t capture_rle_encode(const uint8_t *src, uint8_t *dst, int len)
+{
+   uint32_t out = 0;
+   int literal_start = 0;
+   int i = 0;
+
+   while(i<len)
+   {
+      int run = 1;
+      while(i+run<len&&run<130&&src[i+run]==src[i])
+         run++;
+
+      if(run<3)
+      {
+         i+=run;
+         continue;
+      }
+
+      out+=capture_rle_literals(src+literal_start,dst+out,i-literal_start);
+      dst[out++] = 125+run;
+      dst[out++] = src[i];
+      i+=run;
+      literal_start = i;
+   }
+   out+=capture_rle_literals(src+literal_start,dst+out,len-literal_start);
+
+   return out;
+}
+
+static uint32_t capture_rle_literals(const uint8_t *src, uint8_t *dst, int len)
+{
+   uint32_t out = 0;
+
+   while(len>0)
+   {
+      int count = RvR_min(len,128);
+      dst[out++] = count-1;
+      memcpy(dst+out,src,count);
+      out+=count;
+      src+=count;
+      len-=count;
+   }
+
+   return out;
+}
+//-------------------------------------
@@ -113,11 +113,18 @@ void *RvR_decompress(RvR_rw *in, int32_t *length)
    RvR_rw_endian(in,RVR_LITTLE_ENDIAN);
    *length = RvR_rw_read_u32(in);
 
-   uint8_t *buffer_out = RvR_malloc((*length)+1);
+   RvR_error_check(*length>=0,"RvR_decompress","invalid length %d\n",*length);
+
+   uint8_t *buffer_out = RvR_malloc((size_t)(*length)+1);
+   RvR_error_check(buffer_out!=NULL,"RvR_decompress","failed to allocate buffer for %d bytes\n",*length);
    comp_crush_decompress(in,buffer_out,*length);
    buffer_out[*length] = 0;
 
    return buffer_out;
+
+RvR_err:
+   *length = 0;
+   return NULL;
 }
 
 //comp_crush_compress, comp_crush_decompress, comp_update_hash1, comp_update_hash2, comp_bits_init, comp_get_penalty, comp_bits_put, comp_bits_get, comp_bits_flush
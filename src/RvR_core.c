@@ -20,18 +20,61 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //#defines
+#define CORE_TICK_LENGTH (1000000/RVR_FPS)
+#define CORE_TICKS_MAX 8
+
+//Gamepads recorded in replays
+#define CORE_PADS 4
+
+#define CORE_REPLAY_VERSION 1
+
+#define CORE_REPLAY_KEYS 1
+#define CORE_REPLAY_PADS 2
+#define CORE_REPLAY_MOUSE 4
+#define CORE_REPLAY_WHEEL 8
+#define CORE_REPLAY_TEXT 16
 //-------------------------------------
 
 //Typedefs
+typedef struct
+{
+   uint8_t new_key_state[RVR_KEY_MAX];
+   uint8_t old_key_state[RVR_KEY_MAX];
+   uint8_t new_pad_state[CORE_PADS][RVR_PAD_MAX];
+   uint8_t old_pad_state[CORE_PADS][RVR_PAD_MAX];
+   int mouse_x;
+   int mouse_y;
+   int mouse_x_rel;
+   int mouse_y_rel;
+   int mouse_wheel;
+}core_input;
 //-------------------------------------
 
 //Variables
 static int core_running = 1;
 static uint32_t core_frame = 0;
 static int core_frametimes[32] = {0};
+static int32_t core_tick_accumulator = 0;
+static int core_ticks = 0;
+
+//Input record/replay
+//Each frame only stores what changed compared to the last one
+static int core_recording = 0;
+static int core_replaying = 0;
+static RvR_rw core_replay_rw;
+static char *core_record_path = NULL;
+static uint8_t *core_replay_mem = NULL;
+static core_input core_replay;
+static char *core_text = NULL;
+static int core_text_max = 0;
+static char *core_text_last = NULL;
 //-------------------------------------
 
 //Function prototypes
+static void core_record_frame();
+static void core_replay_frame();
+//-------------------------------------
+
 //-------------------------------------
 
 //Function implementations
@@ -61,6 +104,21 @@ void RvR_core_key_repeat(int repeat)
    RvR_backend_key_repeat(repeat);
 }
 
+void RvR_core_present_threads(int threads)
+{
+   RvR_backend_present_threads(threads);
+}
+
+void RvR_core_present_dirty(int dirty)
+{
+   RvR_backend_present_dirty(dirty);
+}
+
+void RvR_core_present_pipelined(int pipelined)
+{
+   RvR_backend_present_pipelined(pipelined);
+}
+
 int RvR_core_running()
 {
    return core_running;
@@ -70,57 +128,119 @@ void RvR_core_update()
 {
    core_frame++;
    core_frametimes[core_frame&31] = RvR_core_frametime();
+   RvR_frame_reset();
+   RvR_malloc_profile_frame();
 
    RvR_backend_update();
+   RvR_telemetry_record(core_frame,RvR_backend_frametime()*100,RvR_backend_frame_delta());
+
+   //Accumulate real time into fixed length ticks,
+   //dropping time if the game falls too far behind
+   core_tick_accumulator+=RvR_min(RvR_backend_frame_delta(),CORE_TICK_LENGTH*CORE_TICKS_MAX);
+   core_ticks = core_tick_accumulator/CORE_TICK_LENGTH;
+   core_tick_accumulator-=core_ticks*CORE_TICK_LENGTH;
+
+   //Recordings store the tick count of every frame, replays use it instead
+   if(core_recording)
+      core_record_frame();
+   if(core_replaying)
+      core_replay_frame();
+}
+
+int RvR_core_ticks()
+{
+   return core_ticks;
+}
+
+RvR_fix22 RvR_core_tick_alpha()
+{
+   return (core_tick_accumulator*1024)/CORE_TICK_LENGTH;
+}
+
+void RvR_core_fps(int fps)
+{
+   RvR_backend_fps(fps);
+}
+
+void RvR_core_frame_pacing(int precise)
+{
+   RvR_backend_frame_pacing(precise);
 }
 
 void RvR_core_render_present()
 {
+   RvR_capture_frame();
    RvR_backend_render_present();
 }
 
 int RvR_core_key_down(RvR_key key)
 {
+   if(core_replaying)
+      return core_replay.new_key_state[key];
    return RvR_backend_key_down(key);
 }
 
 int RvR_core_key_pressed(RvR_key key)
 {
+   if(core_replaying)
+      return core_replay.new_key_state[key]&&!core_replay.old_key_state[key];
    return RvR_backend_key_pressed(key);
 }
 
 int RvR_core_key_released(RvR_key key)
 {
+   if(core_replaying)
+      return !core_replay.new_key_state[key]&&core_replay.old_key_state[key];
    return RvR_backend_key_released(key);
 }
 
 int RvR_core_mouse_wheel_scroll()
 {
+   if(core_replaying)
+      return core_replay.mouse_wheel;
    return RvR_backend_mouse_wheel_get_scroll();
 }
 
 int RvR_core_gamepad_down(int index, RvR_gamepad_button button)
 {
+   if(core_replaying)
+      return index<CORE_PADS&&core_replay.new_pad_state[index][button];
    return RvR_backend_gamepad_down(index,button);
 }
 
 int RvR_core_gamepad_pressed(int index, RvR_gamepad_button button)
 {
+   if(core_replaying)
+      return index<CORE_PADS&&core_replay.new_pad_state[index][button]&&!core_replay.old_pad_state[index][button];
    return RvR_backend_gamepad_pressed(index,button);
 }
 
 int RvR_core_gamepad_released(int index, RvR_gamepad_button button)
 {
+   if(core_replaying)
+      return index<CORE_PADS&&!core_replay.new_pad_state[index][button]&&core_replay.old_pad_state[index][button];
    return RvR_backend_gamepad_released(index,button);
 }
 
 void RvR_core_mouse_relative_pos(int *x, int *y)
 {
+   if(core_replaying)
+   {
+      *x = core_replay.mouse_x_rel;
+      *y = core_replay.mouse_y_rel;
+      return;
+   }
    RvR_backend_mouse_get_relative_pos(x,y);
 }
 
 void RvR_core_mouse_pos(int *x, int *y)
 {
+   if(core_replaying)
+   {
+      *x = core_replay.mouse_x;
+      *y = core_replay.mouse_y;
+      return;
+   }
    RvR_backend_mouse_get_pos(x,y);
 }
 
@@ -131,14 +251,251 @@ void RvR_core_mouse_set_pos(int x, int y)
 
 void RvR_core_text_input_start(char *text, int max_length)
 {
+   core_text = text;
+   core_text_max = max_length;
    RvR_backend_text_input_start(text,max_length);
 }
 
 void RvR_core_text_input_end()
 {
+   core_text = NULL;
    RvR_backend_text_input_end();
 }
 
+void RvR_core_record_start(const char *path)
+{
+   RvR_core_record_end();
+
+   core_record_path = RvR_malloc(strlen(path)+1);
+   strcpy(core_record_path,path);
+
+   RvR_rw_init_dyn_mem(&core_replay_rw,1<<16,1<<16);
+   RvR_rw_write_u8(&core_replay_rw,'R');
+   RvR_rw_write_u8(&core_replay_rw,'V');
+   RvR_rw_write_u8(&core_replay_rw,'R');
+   RvR_rw_write_u8(&core_replay_rw,'I');
+   RvR_rw_write_u16(&core_replay_rw,CORE_REPLAY_VERSION);
+   RvR_rw_write_u16(&core_replay_rw,RVR_KEY_MAX);
+   RvR_rw_write_u16(&core_replay_rw,RVR_PAD_MAX);
+
+   memset(&core_replay,0,sizeof(core_replay));
+   core_text_last = RvR_realloc(core_text_last,1);
+   core_text_last[0] = '\0';
+   core_recording = 1;
+}
+
+//Compresses the recording and writes it to disk
+void RvR_core_record_end()
+{
+   if(!core_recording)
+      return;
+   core_recording = 0;
+
+   RvR_rw out;
+   RvR_rw_init_path(&out,core_record_path,"wb");
+   if(RvR_rw_valid(&out))
+   {
+      RvR_compress(&core_replay_rw,&out,0);
+      RvR_rw_close(&out);
+   }
+
+   RvR_rw_close(&core_replay_rw);
+   RvR_free(core_record_path);
+   core_record_path = NULL;
+}
+
+void RvR_core_replay_start(const char *path)
+{
+   RvR_core_record_end();
+   RvR_core_replay_end();
+
+   RvR_rw rw;
+   int32_t size = 0;
+   RvR_rw_init_path(&rw,path,"rb");
+   if(!RvR_rw_valid(&rw))
+      return;
+   core_replay_mem = RvR_decompress(&rw,&size);
+   RvR_rw_close(&rw);
+   if(core_replay_mem==NULL)
+   {
+      RvR_log_line("RvR_core_replay_start","failed to decompress '%s'\n",path);
+      return;
+   }
+
+   RvR_rw_init_const_mem(&core_replay_rw,core_replay_mem,size);
+   char magic[4];
+   RvR_rw_read(&core_replay_rw,magic,1,4);
+   uint16_t version = RvR_rw_read_u16(&core_replay_rw);
+   uint16_t keys = RvR_rw_read_u16(&core_replay_rw);
+   uint16_t buttons = RvR_rw_read_u16(&core_replay_rw);
+   if(memcmp(magic,"RVRI",4)!=0||version!=CORE_REPLAY_VERSION||keys!=RVR_KEY_MAX||buttons!=RVR_PAD_MAX)
+   {
+      RvR_log_line("RvR_core_replay_start","'%s' is not a valid replay for this build\n",path);
+      RvR_rw_close(&core_replay_rw);
+      RvR_free(core_replay_mem);
+      core_replay_mem = NULL;
+      return;
+   }
+
+   memset(&core_replay,0,sizeof(core_replay));
+   core_replaying = 1;
+}
+
+void RvR_core_replay_end()
+{
+   if(!core_replaying)
+      return;
+   core_replaying = 0;
+
+   RvR_rw_close(&core_replay_rw);
+   RvR_free(core_replay_mem);
+   core_replay_mem = NULL;
+}
+
+int RvR_core_replaying()
+{
+   return core_replaying;
+}
+
+static void core_record_frame()
+{
+   RvR_rw *rw = &core_replay_rw;
+   core_input in;
+   uint8_t flags = 0;
+   int changed_keys = 0;
+   int changed_buttons = 0;
+
+   for(int i = 0;i<RVR_KEY_MAX;i++)
+   {
+      in.new_key_state[i] = RvR_backend_key_down(i);
+      changed_keys+=in.new_key_state[i]!=core_replay.new_key_state[i];
+   }
+   for(int i = 0;i<CORE_PADS;i++)
+   {
+      for(int j = 0;j<RVR_PAD_MAX;j++)
+      {
+         in.new_pad_state[i][j] = RvR_backend_gamepad_down(i,j);
+         changed_buttons+=in.new_pad_state[i][j]!=core_replay.new_pad_state[i][j];
+      }
+   }
+   RvR_backend_mouse_get_pos(&in.mouse_x,&in.mouse_y);
+   RvR_backend_mouse_get_relative_pos(&in.mouse_x_rel,&in.mouse_y_rel);
+   in.mouse_wheel = RvR_backend_mouse_wheel_get_scroll();
+
+   if(changed_keys)
+      flags|=CORE_REPLAY_KEYS;
+   if(changed_buttons)
+      flags|=CORE_REPLAY_PADS;
+   if(in.mouse_x!=core_replay.mouse_x||in.mouse_y!=core_replay.mouse_y||in.mouse_x_rel!=0||in.mouse_y_rel!=0)
+      flags|=CORE_REPLAY_MOUSE;
+   if(in.mouse_wheel!=0)
+      flags|=CORE_REPLAY_WHEEL;
+   if(core_text!=NULL&&strcmp(core_text,core_text_last)!=0)
+      flags|=CORE_REPLAY_TEXT;
+
+   RvR_rw_write_u8(rw,flags);
+   RvR_rw_write_u8(rw,core_ticks);
+   if(flags&CORE_REPLAY_KEYS)
+   {
+      RvR_rw_write_u8(rw,changed_keys);
+      for(int i = 0;i<RVR_KEY_MAX;i++)
+         if(in.new_key_state[i]!=core_replay.new_key_state[i])
+            RvR_rw_write_u8(rw,i);
+   }
+   if(flags&CORE_REPLAY_PADS)
+   {
+      RvR_rw_write_u8(rw,changed_buttons);
+      for(int i = 0;i<CORE_PADS;i++)
+         for(int j = 0;j<RVR_PAD_MAX;j++)
+            if(in.new_pad_state[i][j]!=core_replay.new_pad_state[i][j])
+               RvR_rw_write_u8(rw,i*RVR_PAD_MAX+j);
+   }
+   if(flags&CORE_REPLAY_MOUSE)
+   {
+      RvR_rw_write_u16(rw,in.mouse_x);
+      RvR_rw_write_u16(rw,in.mouse_y);
+      RvR_rw_write_u16(rw,in.mouse_x_rel);
+      RvR_rw_write_u16(rw,in.mouse_y_rel);
+   }
+   if(flags&CORE_REPLAY_WHEEL)
+      RvR_rw_write_u16(rw,in.mouse_wheel);
+   if(flags&CORE_REPLAY_TEXT)
+   {
+      unsigned len = strlen(core_text);
+      RvR_rw_write_u16(rw,len);
+      RvR_rw_write(rw,core_text,1,len);
+      core_text_last = RvR_realloc(core_text_last,len+1);
+      strcpy(core_text_last,core_text);
+   }
+
+   memcpy(core_replay.new_key_state,in.new_key_state,sizeof(in.new_key_state));
+   memcpy(core_replay.new_pad_state,in.new_pad_state,sizeof(in.new_pad_state));
+   core_replay.mouse_x = in.mouse_x;
+   core_replay.mouse_y = in.mouse_y;
+}
+
+static void core_replay_frame()
+{
+   RvR_rw *rw = &core_replay_rw;
+
+   if(RvR_rw_eof(rw))
+   {
+      RvR_log("replay finished\n");
+      RvR_core_replay_end();
+      RvR_core_quit();
+      return;
+   }
+
+   memcpy(core_replay.old_key_state,core_replay.new_key_state,sizeof(core_replay.new_key_state));
+   memcpy(core_replay.old_pad_state,core_replay.new_pad_state,sizeof(core_replay.new_pad_state));
+   core_replay.mouse_x_rel = 0;
+   core_replay.mouse_y_rel = 0;
+   core_replay.mouse_wheel = 0;
+
+   uint8_t flags = RvR_rw_read_u8(rw);
+   uint8_t ticks = RvR_rw_read_u8(rw);
+   core_ticks = RvR_min(ticks,CORE_TICKS_MAX);
+   if(flags&CORE_REPLAY_KEYS)
+   {
+      int count = RvR_rw_read_u8(rw);
+      for(int i = 0;i<count;i++)
+      {
+         uint8_t key = RvR_rw_read_u8(rw)%RVR_KEY_MAX;
+         core_replay.new_key_state[key] = !core_replay.new_key_state[key];
+      }
+   }
+   if(flags&CORE_REPLAY_PADS)
+   {
+      int count = RvR_rw_read_u8(rw);
+      for(int i = 0;i<count;i++)
+      {
+         unsigned button = RvR_rw_read_u8(rw)%(CORE_PADS*RVR_PAD_MAX);
+         core_replay.new_pad_state[button/RVR_PAD_MAX][button%RVR_PAD_MAX]^=1;
+      }
+   }
+   if(flags&CORE_REPLAY_MOUSE)
+   {
+      core_replay.mouse_x = (int16_t)RvR_rw_read_u16(rw);
+      core_replay.mouse_y = (int16_t)RvR_rw_read_u16(rw);
+      core_replay.mouse_x_rel = (int16_t)RvR_rw_read_u16(rw);
+      core_replay.mouse_y_rel = (int16_t)RvR_rw_read_u16(rw);
+   }
+   if(flags&CORE_REPLAY_WHEEL)
+      core_replay.mouse_wheel = (int16_t)RvR_rw_read_u16(rw);
+   if(flags&CORE_REPLAY_TEXT)
+   {
+      unsigned len = RvR_rw_read_u16(rw);
+      for(unsigned i = 0;i<len;i++)
+      {
+         char c = RvR_rw_read_u8(rw);
+         if(core_text!=NULL&&(int)i<core_text_max-1)
+            core_text[i] = c;
+      }
+      if(core_text!=NULL)
+         core_text[RvR_min((int)len,core_text_max-1)] = '\0';
+   }
+}
+
 uint8_t *RvR_core_framebuffer()
 {
    return RvR_backend_framebuffer();
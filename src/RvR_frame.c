@@ -0,0 +1,135 @@
+/*
+RvnicRaven retro game engine
+
+Written in 2021,2022 by Lukas Holzbeierlein (Captain4LK) email: captain4lk [at] tutanota [dot] com
+
+To the extent possible under law, the author(s) have dedicated all copyright and related and neighboring rights to this software to the public domain worldwide. This software is distributed without any warranty.
+
+You should have received a copy of the CC0 Public Domain Dedication along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+/*
+Per frame scratch memory, allocations are carved linearly out of
+a fixed arena and all get released at once by RvR_frame_reset(),
+which RvR_core_update() calls every frame.
+
+If the arena runs out, allocations fall back to RvR_malloc()
+and get freed on the next reset (or release). Increase
+RVR_FRAME_ARENA if this gets logged.
+
+Main thread only.
+*/
+
+//External includes
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+//-------------------------------------
+
+//Internal includes
+#include "RvnicRaven.h"
+//-------------------------------------
+
+//#defines
+#define FRAME_ALIGN 8
+//-------------------------------------
+
+//Typedefs
+typedef struct Frame_overflow
+{
+   struct Frame_overflow *next;
+   uint64_t align; //Keeps the memory following the header aligned
+}Frame_overflow;
+//-------------------------------------
+
+//Variables
+static uint8_t *frame_arena = NULL;
+static size_t frame_used = 0;
+static size_t frame_peak = 0;
+
+//Newest first
+static Frame_overflow *frame_overflow = NULL;
+static uint32_t frame_overflow_count = 0;
+static int frame_overflow_logged = 0;
+//-------------------------------------
+
+//Function prototypes
+static void frame_overflow_free(uint32_t keep);
+//-------------------------------------
+
+//Function implementations
+
+//Memory is aligned to 8 bytes and stays valid until the next
+//RvR_frame_reset(), or until released through a mark taken before
+void *RvR_frame_alloc(size_t size)
+{
+   if(frame_arena==NULL)
+      frame_arena = RvR_malloc(RVR_FRAME_ARENA);
+
+   size = (size+FRAME_ALIGN-1)&~(size_t)(FRAME_ALIGN-1);
+
+   if(frame_arena!=NULL&&size<=RVR_FRAME_ARENA-frame_used)
+   {
+      void *mem = frame_arena+frame_used;
+      frame_used+=size;
+      frame_peak = RvR_max(frame_peak,frame_used);
+
+      return mem;
+   }
+
+   if(!frame_overflow_logged)
+   {
+      RvR_log("RvR_frame: arena of %d bytes exhausted, falling back to RvR_malloc\n",RVR_FRAME_ARENA);
+      frame_overflow_logged = 1;
+   }
+
+   Frame_overflow *o = RvR_malloc(sizeof(*o)+size);
+   if(o==NULL)
+      return NULL;
+   o->next = frame_overflow;
+   frame_overflow = o;
+   frame_overflow_count++;
+
+   return o+1;
+}
+
+void RvR_frame_reset()
+{
+   frame_used = 0;
+   frame_overflow_free(0);
+}
+
+//Everything allocated after taking a mark can be released
+//without affecting older allocations, marks nest
+RvR_frame_marker RvR_frame_mark()
+{
+   RvR_frame_marker mark;
+   mark.used = frame_used;
+   mark.overflow = frame_overflow_count;
+
+   return mark;
+}
+
+void RvR_frame_release(RvR_frame_marker mark)
+{
+   frame_used = mark.used;
+   frame_overflow_free(mark.overflow);
+}
+
+//Highest amount of arena memory in use at once
+size_t RvR_frame_peak()
+{
+   return frame_peak;
+}
+
+static void frame_overflow_free(uint32_t keep)
+{
+   while(frame_overflow_count>keep)
+   {
+      Frame_overflow *o = frame_overflow;
+      frame_overflow = o->next;
+      frame_overflow_count--;
+      RvR_free(o);
+   }
+}
+//-------------------------------------
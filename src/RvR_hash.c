@@ -25,11 +25,15 @@ FNV hash algorithms and source code have been released into the public domain.
 The authors of the FNV algorithmm took deliberate steps to disclose the algorhtm in a public forum soon after it was invented.
 More than a year passed after this public disclosure and the authors deliberatly took no steps to patent the FNV algorithm.
 Therefore it is safe to say that the FNV authors have no patent claims on the FNV algorithm as published.
+
+FNV works on one byte at a time, RvR_hash() reads 8 bytes at once and
+is a lot faster for anything longer than a few bytes.
 */
 
 //External includes
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 //-------------------------------------
 
 //Internal includes
@@ -39,6 +43,12 @@ Therefore it is safe to say that the FNV authors have no patent claims on the FN
 //#defines
 #define FNV_64_PRIME ((uint64_t)0x100000001b3ULL)
 #define FNV_32_PRIME ((uint32_t)0x01000193)
+
+//wyhash constants
+#define HASH_SECRET0 ((uint64_t)0xa0761d6478bd642fULL)
+#define HASH_SECRET1 ((uint64_t)0xe7037ed1a0b428dbULL)
+#define HASH_SECRET2 ((uint64_t)0x8ebc6af09c88c6e3ULL)
+#define HASH_SECRET3 ((uint64_t)0x589965cc75374cc3ULL)
 //-------------------------------------
 
 //Typedefs
@@ -48,6 +58,9 @@ Therefore it is safe to say that the FNV authors have no patent claims on the FN
 //-------------------------------------
 
 //Function prototypes
+static uint64_t hash_mum(uint64_t a, uint64_t b);
+static uint64_t hash_read(const uint8_t *p);
+static void     hash_block(uint64_t *lanes, const uint8_t *p);
 //-------------------------------------
 
 //Function implementations
@@ -134,6 +147,152 @@ RvR_err:
    return hval;
 }
 
+//Word at a time hash, in the style of wyhash: 32 byte blocks are fed into
+//two lanes, each folding the 128 bit product of two 64 bit words.
+//Results depend on the byte order of the machine, don't store them
+uint64_t RvR_hash(const void *buf, size_t len, uint64_t seed)
+{
+   RvR_hash_state s;
+   RvR_hash_begin(&s,seed);
+   RvR_hash_update(&s,buf,len);
+
+   return RvR_hash_end(&s);
+}
+
+uint64_t RvR_hash_str(const char *str, uint64_t seed)
+{
+   RvR_error_check(str!=NULL,"RvR_hash_str","argument 'str' must be non-NULL\n");
+
+   return RvR_hash(str,strlen(str),seed);
+
+RvR_err:
+   return seed;
+}
+
+//Mixes all bits of an integer, e.g. for using ids as hash map keys
+uint64_t RvR_hash_u64(uint64_t v)
+{
+   return hash_mum(v^HASH_SECRET0,HASH_SECRET1)^v;
+}
+
+void RvR_hash_begin(RvR_hash_state *s, uint64_t seed)
+{
+   s->lanes[0] = seed^HASH_SECRET0;
+   s->lanes[1] = seed^HASH_SECRET1;
+   s->length = 0;
+   s->buffer_used = 0;
+}
+
+//The result only depends on the data, not on how it was split up
+void RvR_hash_update(RvR_hash_state *s, const void *buf, size_t len)
+{
+   const uint8_t *p = buf;
+   s->length+=len;
+
+   //Complete a buffered block first
+   if(s->buffer_used>0)
+   {
+      size_t fill = RvR_min(len,32-s->buffer_used);
+      memcpy(s->buffer+s->buffer_used,p,fill);
+      s->buffer_used+=fill;
+      p+=fill;
+      len-=fill;
+
+      if(s->buffer_used<32)
+         return;
+      hash_block(s->lanes,s->buffer);
+      s->buffer_used = 0;
+   }
+
+   for(;len>=32;p+=32,len-=32)
+      hash_block(s->lanes,p);
+
+   memcpy(s->buffer,p,len);
+   s->buffer_used = len;
+}
+
+//Doesn't modify the state, more data can be added afterwards
+uint64_t RvR_hash_end(const RvR_hash_state *s)
+{
+   uint64_t h = s->lanes[0]^hash_mum(s->lanes[1],HASH_SECRET2);
+   const uint8_t *p = s->buffer;
+   size_t len = s->buffer_used;
+
+   for(;len>16;p+=16,len-=16)
+      h = hash_mum(hash_read(p)^HASH_SECRET2,hash_read(p+8)^h);
+
+   uint8_t tail[16] = {0};
+   memcpy(tail,p,len);
+   h = hash_mum(hash_read(tail)^HASH_SECRET3,hash_read(tail+8)^h^len);
+
+   return hash_mum(h^HASH_SECRET0,s->length^HASH_SECRET1);
+}
+
+//Hash and equality functions for RvR_map_* keyed by integers or strings
+uint32_t RvR_map_hash_u32(const uint32_t *k)
+{
+   return (uint32_t)RvR_hash_u64(*k);
+}
+
+int RvR_map_equal_u32(const uint32_t *a, const uint32_t *b)
+{
+   return *a==*b;
+}
+
+uint32_t RvR_map_hash_u64(const uint64_t *k)
+{
+   return (uint32_t)RvR_hash_u64(*k);
+}
+
+int RvR_map_equal_u64(const uint64_t *a, const uint64_t *b)
+{
+   return *a==*b;
+}
+
+//The map only stores the pointer, the string must outlive its entry
+uint32_t RvR_map_hash_str(const char * const *k)
+{
+   return (uint32_t)RvR_hash(*k,strlen(*k),0);
+}
+
+int RvR_map_equal_str(const char * const *a, const char * const *b)
+{
+   return strcmp(*a,*b)==0;
+}
+
+//Folds the 128 bit product
+static uint64_t hash_mum(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+   __uint128_t r = (__uint128_t)a*b;
+
+   return (uint64_t)r^(uint64_t)(r>>64);
+#else
+   uint64_t ha = a>>32, la = (uint32_t)a;
+   uint64_t hb = b>>32, lb = (uint32_t)b;
+   uint64_t hh = ha*hb, hl = ha*lb, lh = la*hb, ll = la*lb;
+   uint64_t t = ll+(hl<<32);
+   uint64_t lo = t+(lh<<32);
+   uint64_t hi = hh+(hl>>32)+(lh>>32)+(t<ll)+(lo<t);
+
+   return lo^hi;
+#endif
+}
+
+static uint64_t hash_read(const uint8_t *p)
+{
+   uint64_t v;
+   memcpy(&v,p,sizeof(v));
+
+   return v;
+}
+
+static void hash_block(uint64_t *lanes, const uint8_t *p)
+{
+   lanes[0] = hash_mum(hash_read(p)^HASH_SECRET0,hash_read(p+8)^lanes[0]);
+   lanes[1] = hash_mum(hash_read(p+16)^HASH_SECRET1,hash_read(p+24)^lanes[1]);
+}
+
 #undef RNV_64_PRIME
 #undef RNV_32_PRIME
 //-------------------------------------
@@ -0,0 +1,189 @@
+/*
+RvnicRaven retro game engine
+
+Written in 2021,2022 by Lukas Holzbeierlein (Captain4LK) email: captain4lk [at] tutanota [dot] com
+
+To the extent possible under law, the author(s) have dedicated all copyright and related and neighboring rights to this software to the public domain worldwide. This software is distributed without any warranty.
+
+You should have received a copy of the CC0 Public Domain Dedication along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+//External includes
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+//-------------------------------------
+
+//Internal includes
+#include "RvnicRaven.h"
+//-------------------------------------
+
+//#defines
+//Maximum length of a stored deflate block
+#define IMAGE_DEFLATE_BLOCK 65535
+//-------------------------------------
+
+//Typedefs
+//-------------------------------------
+
+//Variables
+static uint32_t image_crc_table[256];
+static int image_crc_init = 0;
+//-------------------------------------
+
+//Function prototypes
+static void image_png_chunk(RvR_rw *rw, const char *type, const uint8_t *data, uint32_t len);
+static uint32_t image_crc(uint32_t crc, const uint8_t *data, uint32_t len);
+//-------------------------------------
+
+//Function implementations
+
+void RvR_image_write_ppm(RvR_rw *rw, int width, int height, const uint8_t *data, const RvR_color *pal)
+{
+   RvR_rw_printf(rw,"P6\n%d %d\n255\n",width,height);
+
+   for(int i = 0;i<width*height;i++)
+   {
+      RvR_rw_write_u8(rw,pal[data[i]].r);
+      RvR_rw_write_u8(rw,pal[data[i]].g);
+      RvR_rw_write_u8(rw,pal[data[i]].b);
+   }
+}
+
+//Writes an indexed png, the image data is stored uncompressed
+//(deflate stored blocks), which keeps writing cheap at the cost
+//of file size. Doesn't allocate, so it can be used from any thread
+void RvR_image_write_png(RvR_rw *rw, int width, int height, const uint8_t *data, const RvR_color *pal)
+{
+   uint8_t tmp[768];
+   uint32_t raw_len = (uint32_t)(width+1)*height;
+   uint32_t blocks = (raw_len+IMAGE_DEFLATE_BLOCK-1)/IMAGE_DEFLATE_BLOCK;
+   uint32_t idat_len = 2+blocks*5+raw_len+4;
+
+   static const uint8_t signature[8] = {137,80,78,71,13,10,26,10};
+   RvR_rw_write(rw,signature,1,8);
+
+   //IHDR
+   tmp[0] = (width>>24)&255; tmp[1] = (width>>16)&255; tmp[2] = (width>>8)&255; tmp[3] = width&255;
+   tmp[4] = (height>>24)&255; tmp[5] = (height>>16)&255; tmp[6] = (height>>8)&255; tmp[7] = height&255;
+   tmp[8] = 8; //Bit depth
+   tmp[9] = 3; //Indexed color
+   tmp[10] = 0;
+   tmp[11] = 0;
+   tmp[12] = 0;
+   image_png_chunk(rw,"IHDR",tmp,13);
+
+   //PLTE
+   for(int i = 0;i<256;i++)
+   {
+      tmp[i*3] = pal[i].r;
+      tmp[i*3+1] = pal[i].g;
+      tmp[i*3+2] = pal[i].b;
+   }
+   image_png_chunk(rw,"PLTE",tmp,768);
+
+   //IDAT, zlib stream made of stored blocks
+   //Each row starts with filter type 0
+   //Written in pieces, updating the crc along the way
+   tmp[0] = (idat_len>>24)&255; tmp[1] = (idat_len>>16)&255; tmp[2] = (idat_len>>8)&255; tmp[3] = idat_len&255;
+   tmp[4] = 'I'; tmp[5] = 'D'; tmp[6] = 'A'; tmp[7] = 'T';
+   tmp[8] = 0x78;
+   tmp[9] = 0x01;
+   RvR_rw_write(rw,tmp,1,10);
+   uint32_t crc = image_crc(0xffffffff,tmp+4,6);
+
+   uint32_t s1 = 1;
+   uint32_t s2 = 0;
+   uint32_t pos = 0;
+   uint32_t block_left = 0;
+   for(int y = 0;y<height;y++)
+   {
+      int x = -1;
+      while(x<width)
+      {
+         if(block_left==0)
+         {
+            block_left = RvR_min(IMAGE_DEFLATE_BLOCK,raw_len-pos);
+            tmp[0] = (pos+block_left==raw_len);
+            tmp[1] = block_left&255;
+            tmp[2] = (block_left>>8)&255;
+            tmp[3] = (~block_left)&255;
+            tmp[4] = ((~block_left)>>8)&255;
+            RvR_rw_write(rw,tmp,1,5);
+            crc = image_crc(crc,tmp,5);
+         }
+
+         //Filter byte
+         if(x<0)
+         {
+            tmp[0] = 0;
+            RvR_rw_write(rw,tmp,1,1);
+            crc = image_crc(crc,tmp,1);
+            s2 = (s2+s1)%65521;
+            block_left--;
+            pos++;
+            x++;
+            continue;
+         }
+
+         //As much of the row as fits into the current block
+         uint32_t len = RvR_min((uint32_t)(width-x),block_left);
+         const uint8_t *src = &data[y*width+x];
+         RvR_rw_write(rw,src,1,len);
+         crc = image_crc(crc,src,len);
+         for(uint32_t i = 0;i<len;i++)
+         {
+            s1 = (s1+src[i])%65521;
+            s2 = (s2+s1)%65521;
+         }
+         block_left-=len;
+         pos+=len;
+         x+=len;
+      }
+   }
+   uint32_t adler = (s2<<16)|s1;
+   tmp[0] = (adler>>24)&255; tmp[1] = (adler>>16)&255; tmp[2] = (adler>>8)&255; tmp[3] = adler&255;
+   RvR_rw_write(rw,tmp,1,4);
+   crc = image_crc(crc,tmp,4)^0xffffffff;
+   tmp[0] = (crc>>24)&255; tmp[1] = (crc>>16)&255; tmp[2] = (crc>>8)&255; tmp[3] = crc&255;
+   RvR_rw_write(rw,tmp,1,4);
+
+   image_png_chunk(rw,"IEND",NULL,0);
+}
+
+static void image_png_chunk(RvR_rw *rw, const char *type, const uint8_t *data, uint32_t len)
+{
+   uint8_t tmp[4];
+
+   tmp[0] = (len>>24)&255; tmp[1] = (len>>16)&255; tmp[2] = (len>>8)&255; tmp[3] = len&255;
+   RvR_rw_write(rw,tmp,1,4);
+   RvR_rw_write(rw,type,1,4);
+   if(len>0)
+      RvR_rw_write(rw,data,1,len);
+
+   uint32_t crc = image_crc(0xffffffff,(const uint8_t *)type,4);
+   crc = image_crc(crc,data,len)^0xffffffff;
+   tmp[0] = (crc>>24)&255; tmp[1] = (crc>>16)&255; tmp[2] = (crc>>8)&255; tmp[3] = crc&255;
+   RvR_rw_write(rw,tmp,1,4);
+}
+
+static uint32_t image_crc(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+   if(!image_crc_init)
+   {
+      for(uint32_t i = 0;i<256;i++)
+      {
+         uint32_t c = i;
+         for(int j = 0;j<8;j++)
+            c = (c&1)?0xedb88320^(c>>1):c>>1;
+         image_crc_table[i] = c;
+      }
+      image_crc_init = 1;
+   }
+
+   for(uint32_t i = 0;i<len;i++)
+      crc = image_crc_table[(crc^data[i])&255]^(crc>>8);
+
+   return crc;
+}
+//-------------------------------------
@@ -0,0 +1,500 @@
+/*
+RvnicRaven retro game engine
+
+Written in 2021,2022 by Lukas Holzbeierlein (Captain4LK) email: captain4lk [at] tutanota [dot] com
+
+To the extent possible under law, the author(s) have dedicated all copyright and related and neighboring rights to this software to the public domain worldwide. This software is distributed without any warranty.
+
+You should have received a copy of the CC0 Public Domain Dedication along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+/*
+Job system, a fixed pool of worker threads, each owning a queue.
+Jobs get distributed over all queues, workers take jobs from
+the back of their own queue and steal from the front of the others
+once it runs dry. Threads waiting on a counter run jobs too,
+so jobs may wait on other jobs.
+
+Every job can decrement a counter when it finishes and can depend
+on another counter, in which case it is held back until that
+counter reaches zero. Waiting threads that find nothing to run
+sleep until a job gets queued or a counter reaches zero.
+
+Until RvR_job_init() is called, without threads (e.g. emscripten
+without pthreads), or with RvR_job_init(0), jobs run immediately on
+the calling thread. The engine never starts workers on its own.
+*/
+
+//External includes
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+//-------------------------------------
+
+//Internal includes
+#include "RvnicRaven.h"
+#include "RvR_backend.h"
+//-------------------------------------
+
+//#defines
+//-------------------------------------
+
+//Typedefs
+typedef struct
+{
+   RvR_job_func func;
+   void *data;
+   int start;
+   int end;
+   RvR_job_counter *counter;
+}job;
+
+typedef struct
+{
+   //Jobs [top,bottom) are queued, indices wrap around
+   job jobs[RVR_JOB_QUEUE];
+   unsigned top;
+   unsigned bottom;
+   void *mutex;
+}job_queue;
+
+//Jobs held back until their dependency is done,
+//linked by index+1, 0 ends the list
+typedef struct
+{
+   job j;
+   int next;
+}job_parked;
+//-------------------------------------
+
+//Variables
+static int job_initialized = 0;
+static int job_parked_ready = 0;
+static int job_workers = 0;
+static int job_worker_index[RVR_JOB_THREADS_MAX];
+static void *job_threads[RVR_JOB_THREADS_MAX];
+
+//Queue 0 is used by threads outside the pool
+static job_queue job_queues[RVR_JOB_THREADS_MAX+1];
+static unsigned job_next = 0;
+
+//Guards counters, parked jobs, job_next, job_queued,
+//job_sleepers and job_quitting
+static void *job_mutex = NULL;
+static void *job_wake = NULL;
+
+//Threads sleeping in RvR_job_wait() on job_progress,
+//woken when a job gets queued or a counter reaches zero
+static void *job_progress = NULL;
+static int job_sleepers = 0;
+static int job_queued = 0;
+static int job_quitting = 0;
+
+static job_parked job_parked_pool[RVR_JOB_QUEUE];
+static int job_parked_free = 0;
+//-------------------------------------
+
+//Function prototypes
+static void job_init_default();
+static int  job_worker(void *data);
+static void job_submit(const job *j);
+static int  job_get(int queue, job *j);
+static void job_execute(const job *j);
+static void job_notify();
+static void job_lock();
+static void job_unlock();
+//-------------------------------------
+
+//Function implementations
+
+//workers<0 uses one worker less than the amount of cpu cores,
+//since the calling thread helps while waiting.
+//Must not be called while jobs are running, later calls
+//are ignored until RvR_job_quit()
+void RvR_job_init(int workers)
+{
+   if(job_initialized)
+      return;
+   job_initialized = 1;
+   job_init_default();
+
+   if(workers<0)
+      workers = RvR_backend_cpu_count()-1;
+   workers = RvR_clamp(workers,0,RVR_JOB_THREADS_MAX);
+
+#if defined(__EMSCRIPTEN__)&&!defined(__EMSCRIPTEN_PTHREADS__)
+   workers = 0;
+#endif
+
+   if(workers==0)
+      return;
+
+   job_mutex = RvR_backend_mutex_create();
+   job_wake = RvR_backend_semaphore_create(0);
+   job_progress = RvR_backend_semaphore_create(0);
+   if(job_mutex==NULL||job_wake==NULL||job_progress==NULL)
+   {
+      RvR_log_line("RvR_job_init ","failed to create synchronization primitives, running jobs serially\n");
+      return;
+   }
+
+   for(int i = 0;i<=workers;i++)
+   {
+      job_queues[i].mutex = RvR_backend_mutex_create();
+      if(job_queues[i].mutex==NULL)
+      {
+         workers = RvR_max(0,i-1);
+         break;
+      }
+   }
+
+   //Worker i owns queue i+1
+   for(int i = 0;i<workers;i++)
+   {
+      job_worker_index[i] = i+1;
+      job_threads[i] = RvR_backend_thread_create(job_worker,&job_worker_index[i]);
+      if(job_threads[i]==NULL)
+         break;
+      job_workers++;
+   }
+}
+
+//Joins the workers, jobs run on the calling thread again afterwards.
+//Must not be called while jobs are queued or running
+void RvR_job_quit()
+{
+   if(!job_initialized)
+      return;
+
+   job_lock();
+   job_quitting = 1;
+   job_unlock();
+
+   for(int i = 0;i<job_workers;i++)
+      RvR_backend_semaphore_post(job_wake);
+   for(int i = 0;i<job_workers;i++)
+   {
+      RvR_backend_thread_wait(job_threads[i]);
+      job_threads[i] = NULL;
+   }
+
+   for(int i = 0;i<=RVR_JOB_THREADS_MAX;i++)
+   {
+      if(job_queues[i].mutex!=NULL)
+         RvR_backend_mutex_destroy(job_queues[i].mutex);
+      job_queues[i].mutex = NULL;
+      job_queues[i].top = 0;
+      job_queues[i].bottom = 0;
+   }
+
+   if(job_mutex!=NULL)
+      RvR_backend_mutex_destroy(job_mutex);
+   if(job_wake!=NULL)
+      RvR_backend_semaphore_destroy(job_wake);
+   if(job_progress!=NULL)
+      RvR_backend_semaphore_destroy(job_progress);
+   job_mutex = NULL;
+   job_wake = NULL;
+   job_progress = NULL;
+
+   job_workers = 0;
+   job_next = 0;
+   job_queued = 0;
+   job_sleepers = 0;
+   job_quitting = 0;
+   job_initialized = 0;
+}
+
+int RvR_job_workers()
+{
+   job_init_default();
+
+   return job_workers;
+}
+
+//Runs func(data,start,end), decrements counter when done (if not NULL)
+//and doesn't start before depends reaches zero (if not NULL)
+void RvR_job_run(RvR_job_func func, void *data, int start, int end, RvR_job_counter *counter, RvR_job_counter *depends)
+{
+   job_init_default();
+
+   job j;
+   j.func = func;
+   j.data = data;
+   j.start = start;
+   j.end = end;
+   j.counter = counter;
+
+   job_lock();
+
+   if(counter!=NULL)
+      counter->value++;
+
+   if(depends!=NULL&&depends->value>0)
+   {
+      if(job_parked_free!=0)
+      {
+         int slot = job_parked_free;
+         job_parked_free = job_parked_pool[slot-1].next;
+         job_parked_pool[slot-1].j = j;
+         job_parked_pool[slot-1].next = depends->parked;
+         depends->parked = slot;
+         job_unlock();
+
+         return;
+      }
+
+      //Out of parked slots, resolve the dependency right here
+      job_unlock();
+      RvR_job_wait(depends);
+      job_submit(&j);
+
+      return;
+   }
+
+   job_unlock();
+   job_submit(&j);
+}
+
+//Runs queued jobs while waiting, sleeps if there are none
+void RvR_job_wait(RvR_job_counter *counter)
+{
+   job_init_default();
+
+   for(;;)
+   {
+      job j;
+      if(job_get(0,&j))
+      {
+         job_execute(&j);
+         continue;
+      }
+
+      if(job_workers==0)
+      {
+         if(RvR_job_done(counter))
+            return;
+         continue;
+      }
+
+      //Checked and registered under the same lock as
+      //job_submit() and job_execute() change them, so no wakeup gets lost
+      job_lock();
+      if(counter->value==0)
+      {
+         job_unlock();
+         return;
+      }
+      int sleep = job_queued==0;
+      if(sleep)
+         job_sleepers++;
+      job_unlock();
+
+      if(sleep)
+         RvR_backend_semaphore_wait(job_progress);
+   }
+}
+
+int RvR_job_done(RvR_job_counter *counter)
+{
+   job_lock();
+   int done = counter->value==0;
+   job_unlock();
+
+   return done;
+}
+
+//Splits [0,count) into ranges of at least grain elements
+//(grain<=0 picks a size), returns once all are done
+void RvR_job_parallel_for(RvR_job_func func, void *data, int count, int grain)
+{
+   job_init_default();
+
+   if(count<=0)
+      return;
+
+   if(job_workers==0)
+   {
+      func(data,0,count);
+      return;
+   }
+
+   //A few ranges per thread to balance uneven work
+   if(grain<=0)
+      grain = RvR_max(1,count/((job_workers+1)*4));
+
+   RvR_job_counter counter = {0};
+   for(int i = 0;i<count;i+=grain)
+      RvR_job_run(func,data,i,RvR_min(count,i+grain),&counter,NULL);
+   RvR_job_wait(&counter);
+}
+
+//Only sets up the parked job list, jobs run on the
+//calling thread until RvR_job_init() starts workers
+static void job_init_default()
+{
+   if(job_parked_ready)
+      return;
+   job_parked_ready = 1;
+
+   job_parked_free = 1;
+   for(int i = 0;i<RVR_JOB_QUEUE;i++)
+      job_parked_pool[i].next = i+1<RVR_JOB_QUEUE?i+2:0;
+}
+
+static int job_worker(void *data)
+{
+   int queue = *((int *)data);
+
+   for(;;)
+   {
+      RvR_backend_semaphore_wait(job_wake);
+
+      job j;
+      while(job_get(queue,&j))
+         job_execute(&j);
+
+      job_lock();
+      int quit = job_quitting;
+      job_unlock();
+      if(quit)
+         return 0;
+   }
+
+   return 0;
+}
+
+static void job_submit(const job *j)
+{
+   if(job_workers==0)
+   {
+      job_execute(j);
+      return;
+   }
+
+   job_lock();
+   job_queue *q = &job_queues[job_next%(job_workers+1)];
+   job_next++;
+   job_unlock();
+
+   RvR_backend_mutex_lock(q->mutex);
+   int full = q->bottom-q->top==RVR_JOB_QUEUE;
+   if(!full)
+   {
+      q->jobs[q->bottom%RVR_JOB_QUEUE] = *j;
+      q->bottom++;
+   }
+   RvR_backend_mutex_unlock(q->mutex);
+
+   if(full)
+   {
+      job_execute(j);
+      return;
+   }
+
+   job_lock();
+   job_queued++;
+   job_unlock();
+
+   RvR_backend_semaphore_post(job_wake);
+   job_notify();
+}
+
+//Newest job of the own queue first, then the oldest of the others
+static int job_get(int queue, job *j)
+{
+   //Jobs run immediately without workers, the queues stay empty
+   if(job_workers==0)
+      return 0;
+
+   for(int i = 0;i<=job_workers;i++)
+   {
+      job_queue *q = &job_queues[(queue+i)%(job_workers+1)];
+      int found = 0;
+
+      RvR_backend_mutex_lock(q->mutex);
+      if(q->bottom!=q->top)
+      {
+         if(i==0)
+            *j = q->jobs[--q->bottom%RVR_JOB_QUEUE];
+         else
+            *j = q->jobs[q->top++%RVR_JOB_QUEUE];
+         found = 1;
+      }
+      RvR_backend_mutex_unlock(q->mutex);
+
+      if(found)
+      {
+         job_lock();
+         job_queued--;
+         job_unlock();
+
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+static void job_execute(const job *j)
+{
+   j->func(j->data,j->start,j->end);
+
+   if(j->counter==NULL)
+      return;
+
+   job_lock();
+   int released = 0;
+   int done = --j->counter->value==0;
+   if(done)
+   {
+      released = j->counter->parked;
+      j->counter->parked = 0;
+   }
+   job_unlock();
+
+   if(done)
+      job_notify();
+
+   //Submit jobs that were waiting for this counter
+   while(released!=0)
+   {
+      job_lock();
+      job next = job_parked_pool[released-1].j;
+      int slot = released;
+      released = job_parked_pool[slot-1].next;
+      job_parked_pool[slot-1].next = job_parked_free;
+      job_parked_free = slot;
+      job_unlock();
+
+      job_submit(&next);
+   }
+}
+
+//Wakes all threads sleeping in RvR_job_wait()
+static void job_notify()
+{
+   if(job_workers==0)
+      return;
+
+   job_lock();
+   int sleepers = job_sleepers;
+   job_sleepers = 0;
+   job_unlock();
+
+   for(int i = 0;i<sleepers;i++)
+      RvR_backend_semaphore_post(job_progress);
+}
+
+static void job_lock()
+{
+   if(job_workers>0)
+      RvR_backend_mutex_lock(job_mutex);
+}
+
+static void job_unlock()
+{
+   if(job_workers>0)
+      RvR_backend_mutex_unlock(job_mutex);
+}
+//-------------------------------------
@@ -17,38 +17,228 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 
 //Internal includes
 #include "RvnicRaven.h"
+#include "RvR_backend.h"
 //-------------------------------------
 
 //#defines
+//Free blocks are kept in segregated lists (TLSF), the first level
+//splits sizes by power of two, the second level linearly
+//into MALLOC_SL_COUNT lists. Blocks below MALLOC_SMALL all
+//share first level 0, with MALLOC_SMALL/MALLOC_SL_COUNT byte steps
+#define MALLOC_ALIGN_LOG 3
+#define MALLOC_ALIGN (1<<MALLOC_ALIGN_LOG)
+#define MALLOC_SL_LOG 4
+#define MALLOC_SL_COUNT (1<<MALLOC_SL_LOG)
+#define MALLOC_FL_SHIFT (MALLOC_SL_LOG+MALLOC_ALIGN_LOG)
+#define MALLOC_FL_COUNT (32-MALLOC_FL_SHIFT+1)
+#define MALLOC_SMALL (1<<MALLOC_FL_SHIFT)
+
+//Every block is framed by a header and a footer (boundary tags)
+//holding its size, negated if free, so both neighbours of a block
+//can be found without walking the heap
+#define MALLOC_TAG ((int32_t)sizeof(Malloc_memory_node))
+#define MALLOC_OVERHEAD (2*MALLOC_TAG)
+#define MALLOC_FOOTER(n,size) ((int32_t *)(((char *)(n))+MALLOC_TAG+(size)))
+
+//Free blocks store their list links in the payload
+#define MALLOC_MIN_SIZE ((int32_t)sizeof(Malloc_free_links))
+#define MALLOC_LINKS(n) ((Malloc_free_links *)(((char *)(n))+MALLOC_TAG))
+
+//Once threads are in use, each thread keeps up to MALLOC_CACHE_MAX
+//freed blocks per size class (up to MALLOC_CACHE_SIZE bytes in
+//MALLOC_ALIGN steps), which it can reuse without taking the heap lock.
+//Needs thread local storage, which C99 doesn't have,
+//without it every allocation takes the lock
+#if defined(_MSC_VER)
+#define MALLOC_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define MALLOC_THREAD_LOCAL __thread
+#endif
+#define MALLOC_CACHE_SIZE 256
+#define MALLOC_CACHE_CLASSES (MALLOC_CACHE_SIZE/MALLOC_ALIGN+1)
+#define MALLOC_CACHE_MAX 32
+
+//The heap consists of up to MALLOC_REGIONS_MAX regions, additional
+//ones get allocated once the existing ones are full (see RVR_MALLOC_GROW).
+//Block sizes are 32 bit, which limits the size of a single region
+#define MALLOC_REGIONS_MAX 32
+#define MALLOC_REGION_MAX ((size_t)1<<30)
+
+//Maximum amount of eviction callbacks
+#define MALLOC_EVICT_MAX 16
+
+//Block lifetimes in frames are histogrammed by power of two
+#define MALLOC_PROFILE_LIFETIMES 8
 //-------------------------------------
 
 //Typedefs
-typedef struct Malloc_memory_node
+typedef struct
 {
   int32_t size;
-  struct Malloc_memory_node *next;
 }Malloc_memory_node;
 
 typedef struct
 {
-   int32_t block_size;
+   Malloc_memory_node *prev;
+   Malloc_memory_node *next;
+}Malloc_free_links;
+
+typedef struct
+{
+   void *mem; //As returned by malloc()
+   size_t bytes;
+   Malloc_memory_node *first;
+   char *end;
+   int32_t size; //Size of the single free block spanning the region when empty
+}Malloc_region;
+
+typedef struct
+{
    void *addr;
-   Malloc_memory_node *sfirst, *slast;
+   size_t total;
+
+   //Sorted by address
+   Malloc_region regions[MALLOC_REGIONS_MAX];
+   int region_count;
+   uint32_t region_generation;
+
+   uint32_t fl_bitmap;
+   uint32_t sl_bitmap[MALLOC_FL_COUNT];
+   Malloc_memory_node *free[MALLOC_FL_COUNT][MALLOC_SL_COUNT];
 }Malloc_block_manager;
+
+typedef struct Malloc_cached
+{
+   struct Malloc_cached *next;
+}Malloc_cached;
+
+typedef struct
+{
+   Malloc_cached *blocks[MALLOC_CACHE_CLASSES];
+   int count[MALLOC_CACHE_CLASSES];
+
+   //Copy of the region table for validating pointers without
+   //taking the lock, refreshed whenever a free misses it
+   Malloc_region regions[MALLOC_REGIONS_MAX];
+   int region_count;
+   uint32_t region_generation;
+}Malloc_cache;
+
+typedef struct
+{
+   RvR_malloc_evict_func func;
+   const char *name;
+   int priority;
+
+   uint32_t calls;
+   uint64_t released;
+}Malloc_evict;
+
+#if RVR_MALLOC_PROFILE
+//Placed in front of every allocation while profiling
+typedef struct
+{
+   uint32_t site;
+   uint32_t frame;
+   uint64_t size;
+}Malloc_profile_header;
+
+typedef struct
+{
+   const char *file;
+   int line;
+
+   uint32_t allocs;
+   uint32_t frees;
+   uint64_t bytes;
+   int64_t live;
+   int64_t live_peak;
+   uint32_t frame_allocs;
+   uint32_t frame_allocs_peak;
+   uint32_t lifetime[MALLOC_PROFILE_LIFETIMES];
+}Malloc_profile_site;
+#endif
 //-------------------------------------
 
 //Variables
 static int malloc_bmanage_total = 0;
 static int malloc_instance = 0;
 static Malloc_block_manager malloc_bmanage = {0};
+
+//Set by RvR_malloc_threads_enable(), until then no locking is done
+static int malloc_threaded = 0;
+static void *malloc_mutex = NULL;
+#ifdef MALLOC_THREAD_LOCAL
+static MALLOC_THREAD_LOCAL Malloc_cache malloc_cache;
+#endif
+
+//Sorted by priority, only touched by the thread that called RvR_malloc_init()
+static Malloc_evict malloc_evict[MALLOC_EVICT_MAX];
+static int malloc_evict_count = 0;
+static int malloc_evicting = 0;
+static uint32_t malloc_evict_runs = 0;
+static uint32_t malloc_evict_recovered = 0;
+#ifdef MALLOC_THREAD_LOCAL
+static MALLOC_THREAD_LOCAL int malloc_main_thread = 0;
+#endif
+
+#if RVR_MALLOC_PROFILE
+//Last entry collects all sites not fitting into the table
+static Malloc_profile_site profile_sites[RVR_MALLOC_PROFILE_SITES+1];
+static int64_t profile_live = 0;
+static int64_t profile_live_peak = 0;
+static uint32_t profile_frames = 0;
+static uint32_t profile_frame_allocs = 0;
+static uint32_t profile_frame_allocs_last = 0;
+static uint32_t profile_frame_allocs_peak = 0;
+static uint64_t profile_frame_bytes = 0;
+static uint64_t profile_frame_bytes_last = 0;
+static uint64_t profile_frame_bytes_peak = 0;
+#endif
 //-------------------------------------
 
 //Function prototypes
-static void  malloc_block_init(Malloc_block_manager *b, void *block, long block_size);
+static int   malloc_region_add(Malloc_block_manager *b, void *mem, size_t bytes);
+static int   malloc_region_grow(Malloc_block_manager *b, int32_t size);
+static int   malloc_region_find(const Malloc_region *regions, int count, const void *ptr);
 static void *malloc_block_alloc(Malloc_block_manager *b, int32_t size);
 static void  malloc_block_free(Malloc_block_manager *b, void *ptr);
+static int   malloc_block_resize(Malloc_block_manager *b, void *ptr, int32_t size);
 static long  malloc_block_pointer_size(void *ptr);
 static void  malloc_block_report(Malloc_block_manager *b);
+
+static size_t malloc_size_round(size_t size);
+static void  malloc_node_set(Malloc_memory_node *n, int32_t size);
+static Malloc_memory_node *malloc_node_next(Malloc_memory_node *n);
+static Malloc_memory_node *malloc_node_prev(Malloc_memory_node *n);
+static void  malloc_node_split(Malloc_block_manager *b, Malloc_memory_node *n, int32_t size);
+
+static void  malloc_mapping(int32_t size, int *fl, int *sl);
+static void  malloc_free_insert(Malloc_block_manager *b, Malloc_memory_node *n);
+static void  malloc_free_remove(Malloc_block_manager *b, Malloc_memory_node *n);
+static Malloc_memory_node *malloc_free_find(Malloc_block_manager *b, int32_t size);
+static int   malloc_fls(uint32_t v);
+static int   malloc_ffs(uint32_t v);
+
+static void *malloc_evict_retry(size_t size);
+
+static void *malloc_cache_get(size_t size);
+static int   malloc_cache_put(void *ptr);
+static void *malloc_alloc(size_t size);
+static void  malloc_release(void *ptr);
+static void *malloc_resize(void *ptr, size_t size);
+
+static void  malloc_lock();
+static void  malloc_unlock();
+
+#if RVR_MALLOC_PROFILE
+static uint32_t malloc_profile_site(const char *file, int line);
+static int   malloc_profile_valid(const Malloc_profile_header *h);
+static void  malloc_profile_alloc(Malloc_profile_header *h, size_t size, uint32_t site);
+static void  malloc_profile_free(const Malloc_profile_header *h);
+static void  malloc_profile_resize(Malloc_profile_header *h, const Malloc_profile_header *old, size_t size, uint32_t site);
+static int   malloc_profile_compare(const void *a, const void *b);
+#endif
 //-------------------------------------
 
 //Function implementations
@@ -66,6 +256,7 @@ void RvR_malloc_init(size_t min, size_t max)
 
    //Clamp min to a minimun value to prevent underflow of size_t
    min = RvR_max(0x100,min);
+   max = RvR_min(MALLOC_REGION_MAX,max);
 
    //This won't work on operating systems where malloc cannont fail
    //and the programm instead just gets killed.
@@ -79,9 +270,13 @@ void RvR_malloc_init(size_t min, size_t max)
 
    if(mem!=NULL)
    {
-      malloc_block_init(&malloc_bmanage,mem,size);
+#ifdef MALLOC_THREAD_LOCAL
+      malloc_main_thread = 1;
+#endif
+      malloc_bmanage.addr = mem;
+      malloc_region_add(&malloc_bmanage,mem,size);
       malloc_bmanage_total++; 
-      RvR_log("RvR_malloc: allocated %d bytes for allocator\n",size);
+      RvR_log("RvR_malloc: allocated %zu bytes for allocator\n",size);
    }  
    else
    {
@@ -89,7 +284,339 @@ void RvR_malloc_init(size_t min, size_t max)
    }
 }
 
-void *RvR_malloc(size_t size)
+//Parenthesized, since RVR_MALLOC_PROFILE turns
+//RvR_malloc() and RvR_realloc() into macros
+void *(RvR_malloc)(size_t size)
+{
+#if RVR_MALLOC_PROFILE
+   return RvR_malloc_at(size,"unknown",0);
+#else
+   return malloc_alloc(size);
+#endif
+}
+
+void RvR_free(void *ptr)
+{
+#if RVR_MALLOC_PROFILE
+   if(ptr!=NULL)
+   {
+      Malloc_profile_header *h = ((Malloc_profile_header *)ptr)-1;
+      if(malloc_profile_valid(h))
+         malloc_profile_free(h);
+      ptr = h;
+   }
+#endif
+
+   malloc_release(ptr);
+}
+
+void *(RvR_realloc)(void *ptr, size_t size)
+{
+#if RVR_MALLOC_PROFILE
+   return RvR_realloc_at(ptr,size,"unknown",0);
+#else
+   return malloc_resize(ptr,size);
+#endif
+}
+
+void *RvR_malloc_base()
+{
+   return malloc_bmanage.addr;
+}
+
+void RvR_malloc_report()
+{
+   if(!malloc_bmanage_total)
+   {
+      RvR_log("RvR_malloc: using system allocator, memory report not possible\n");
+      return;
+   }
+
+   //Blocks held in thread caches show up as allocated
+   malloc_lock();
+   malloc_block_report(&malloc_bmanage);
+   malloc_unlock();
+}
+
+//Must be called before a second thread starts using RvR_malloc,
+//the backend does so when creating threads. Can't be undone
+void RvR_malloc_threads_enable()
+{
+   if(malloc_threaded)
+      return;
+
+   malloc_mutex = RvR_backend_mutex_create();
+   if(malloc_mutex==NULL)
+   {
+      RvR_log("RvR_malloc: failed to create mutex, allocator is not thread safe\n");
+      return;
+   }
+
+   malloc_threaded = 1;
+}
+
+//Returns the blocks cached by the calling thread to the heap,
+//threads that allocate should call this before exiting
+void RvR_malloc_thread_flush()
+{
+#ifdef MALLOC_THREAD_LOCAL
+   if(!malloc_threaded)
+      return;
+
+   malloc_lock();
+   for(int i = 0;i<MALLOC_CACHE_CLASSES;i++)
+   {
+      while(malloc_cache.blocks[i]!=NULL)
+      {
+         Malloc_cached *c = malloc_cache.blocks[i];
+         malloc_cache.blocks[i] = c->next;
+         malloc_block_free(&malloc_bmanage,c);
+      }
+      malloc_cache.count[i] = 0;
+   }
+   malloc_unlock();
+#endif
+}
+
+//Returns regions added by RvR_malloc() that are completely
+//free to the system, returns the amount of bytes released.
+//Blocks held in thread caches keep their region alive
+size_t RvR_malloc_trim()
+{
+   if(!malloc_bmanage_total)
+      return 0;
+
+   size_t released = 0;
+
+   malloc_lock();
+   for(int i = malloc_bmanage.region_count-1;i>=0;i--)
+   {
+      Malloc_region *r = &malloc_bmanage.regions[i];
+      if(r->mem==malloc_bmanage.addr||r->first->size!=-r->size)
+         continue;
+
+      malloc_free_remove(&malloc_bmanage,r->first);
+      free(r->mem);
+      released+=r->bytes;
+      malloc_bmanage.total-=r->bytes;
+
+      malloc_bmanage.region_count--;
+      for(int j = i;j<malloc_bmanage.region_count;j++)
+         malloc_bmanage.regions[j] = malloc_bmanage.regions[j+1];
+      malloc_bmanage.region_generation++;
+   }
+   malloc_unlock();
+
+   if(released>0)
+      RvR_log("RvR_malloc: released %zu bytes\n",released);
+
+   return released;
+}
+
+//Registers a callback releasing cached memory, which RvR_malloc() calls
+//before failing, lowest priority first. It receives the size of the
+//failed allocation and gets called again until it returns 0.
+//Registering a function again only updates it.
+//Callbacks only run on the thread that called RvR_malloc_init()
+//and must be registered from it
+void RvR_malloc_evict_register(RvR_malloc_evict_func func, int priority, const char *name)
+{
+   int index = 0;
+   for(;index<malloc_evict_count;index++)
+      if(malloc_evict[index].func==func)
+         break;
+
+   Malloc_evict e = {0};
+   if(index<malloc_evict_count)
+   {
+      if(malloc_evict[index].priority==priority)
+         return;
+
+      e = malloc_evict[index];
+      malloc_evict_count--;
+      for(int i = index;i<malloc_evict_count;i++)
+         malloc_evict[i] = malloc_evict[i+1];
+   }
+   else if(malloc_evict_count==MALLOC_EVICT_MAX)
+   {
+      RvR_log("RvR_malloc: too many eviction callbacks, ignoring '%s'\n",name);
+      return;
+   }
+
+   e.func = func;
+   e.name = name;
+   e.priority = priority;
+
+   int i = malloc_evict_count;
+   for(;i>0&&malloc_evict[i-1].priority>priority;i--)
+      malloc_evict[i] = malloc_evict[i-1];
+   malloc_evict[i] = e;
+   malloc_evict_count++;
+}
+
+void RvR_malloc_evict_report()
+{
+   RvR_log("RvR_malloc: %u failed allocations ran eviction, %u recovered\n",malloc_evict_runs,malloc_evict_recovered);
+   for(int i = 0;i<malloc_evict_count;i++)
+   {
+      Malloc_evict *e = &malloc_evict[i];
+      RvR_log("   %-16s priority %4d: %u calls, %llu bytes released\n",e->name,e->priority,e->calls,(unsigned long long)e->released);
+   }
+}
+
+//Percentage of free memory outside of the largest free block,
+//0 means all free memory is usable for a single allocation
+int RvR_malloc_fragmentation()
+{
+   if(!malloc_bmanage_total)
+      return 0;
+
+   int64_t free_total = 0;
+   int32_t free_max = 0;
+
+   malloc_lock();
+   for(int i = 0;i<malloc_bmanage.region_count;i++)
+   {
+      for(Malloc_memory_node *n = malloc_bmanage.regions[i].first;n!=NULL;n = malloc_node_next(n))
+      {
+         if(n->size<0)
+         {
+            free_total+=-n->size;
+            free_max = RvR_max(free_max,-n->size);
+         }
+      }
+   }
+   malloc_unlock();
+
+   if(free_total==0)
+      return 0;
+
+   return (int)(100-((int64_t)free_max*100)/free_total);
+}
+
+#if RVR_MALLOC_PROFILE
+
+void *RvR_malloc_at(size_t size, const char *file, int line)
+{
+   //Adding the header could wrap around
+   if(size>INT32_MAX)
+   {
+      RvR_log("RvR_malloc: Allocation of size %zu failed, too large\n",size);
+      return NULL;
+   }
+
+   Malloc_profile_header *h = malloc_alloc(size+sizeof(*h));
+   if(h==NULL)
+      return NULL;
+
+   malloc_profile_alloc(h,size,malloc_profile_site(file,line));
+
+   return h+1;
+}
+
+//Counted as freeing the old and allocating the new block at this site,
+//the block's lifetime still starts at the original allocation
+void *RvR_realloc_at(void *ptr, size_t size, const char *file, int line)
+{
+   if(ptr==NULL)
+      return RvR_malloc_at(size,file,line);
+
+   if(size==0)
+   {
+      RvR_free(ptr);
+      return NULL;
+   }
+
+   if(size>INT32_MAX)
+   {
+      RvR_log("RvR_malloc: Reallocation to size %zu failed, too large\n",size);
+      return NULL;
+   }
+
+   Malloc_profile_header *h = ((Malloc_profile_header *)ptr)-1;
+   if(!malloc_profile_valid(h))
+   {
+      RvR_log("RvR_malloc: realloc() bad pointer\n");
+      return NULL;
+   }
+
+   //The header moves with the block, keep the old one around
+   Malloc_profile_header old = *h;
+   Malloc_profile_header *nh = malloc_resize(h,size+sizeof(*h));
+   if(nh==NULL)
+      return NULL;
+
+   malloc_profile_resize(nh,&old,size,malloc_profile_site(file,line));
+
+   return nh+1;
+}
+
+#endif
+
+//Called by RvR_core_update()
+void RvR_malloc_profile_frame()
+{
+#if RVR_MALLOC_PROFILE
+   malloc_lock();
+   profile_frames++;
+   profile_frame_allocs_peak = RvR_max(profile_frame_allocs_peak,profile_frame_allocs);
+   profile_frame_bytes_peak = RvR_max(profile_frame_bytes_peak,profile_frame_bytes);
+   profile_frame_allocs_last = profile_frame_allocs;
+   profile_frame_bytes_last = profile_frame_bytes;
+   profile_frame_allocs = 0;
+   profile_frame_bytes = 0;
+
+   for(int i = 0;i<=RVR_MALLOC_PROFILE_SITES;i++)
+   {
+      Malloc_profile_site *s = &profile_sites[i];
+      s->frame_allocs_peak = RvR_max(s->frame_allocs_peak,s->frame_allocs);
+      s->frame_allocs = 0;
+   }
+   malloc_unlock();
+#endif
+}
+
+//Lists all call sites, most bytes allocated first.
+//Lifetimes are counted in frames when a block gets freed,
+//the histogram buckets are 0, 1, 2-3, 4-7, ..., 64+
+void RvR_malloc_profile_report()
+{
+#if RVR_MALLOC_PROFILE
+   static int order[RVR_MALLOC_PROFILE_SITES+1];
+   int count = 0;
+   int fragmentation = RvR_malloc_fragmentation();
+
+   malloc_lock();
+   for(int i = 0;i<=RVR_MALLOC_PROFILE_SITES;i++)
+      if(profile_sites[i].allocs>0)
+         order[count++] = i;
+   qsort(order,count,sizeof(*order),malloc_profile_compare);
+
+   RvR_log("************** Allocation profile, %u frames ***************\n",profile_frames);
+   RvR_log("live %lld bytes (peak %lld), last frame %u allocations/%llu bytes, peak frame %u allocations/%llu bytes, fragmentation %d%%\n",
+           (long long)profile_live,(long long)profile_live_peak,
+           profile_frame_allocs_last,(unsigned long long)profile_frame_bytes_last,
+           profile_frame_allocs_peak,(unsigned long long)profile_frame_bytes_peak,
+           fragmentation);
+   RvR_log("    allocs     frees         bytes      live      peak frame max       0     1    2+    4+    8+   16+   32+   64+  site\n");
+
+   for(int i = 0;i<count;i++)
+   {
+      Malloc_profile_site *s = &profile_sites[order[i]];
+      RvR_log("%10u%10u%14llu%10lld%10lld%10u  ",
+              s->allocs,s->frees,(unsigned long long)s->bytes,
+              (long long)s->live,(long long)s->live_peak,s->frame_allocs_peak);
+      for(int j = 0;j<MALLOC_PROFILE_LIFETIMES;j++)
+         RvR_log(" %5u",s->lifetime[j]);
+      RvR_log("  %s:%d\n",s->file,s->line);
+   }
+   malloc_unlock();
+#else
+   RvR_log("RvR_malloc: profiling disabled, compile with RVR_MALLOC_PROFILE=1\n");
+#endif
+}
+
+static void *malloc_alloc(size_t size)
 {
    if(size==0)
       RvR_log("RvR_malloc: tried to malloc 0 bytes\n");
@@ -99,30 +626,47 @@ void *RvR_malloc(size_t size)
       return malloc(size);
    }
 
+   //Blocks are limited to INT32_MAX bytes, checked before
+   //rounding, which wraps around for sizes close to SIZE_MAX
+   if(size>INT32_MAX)
+   {
+      RvR_log("RvR_malloc: Allocation of size %zu failed, too large\n",size);
+      return NULL;
+   }
+
+   size = malloc_size_round(size);
+
+   void *mem = malloc_cache_get(size);
+   if(mem!=NULL)
+      return mem;
+
+   malloc_lock();
    malloc_instance++;
    if(malloc_instance==-1)
       RvR_log("RvR_malloc: mem break\n");
 
-   size = (size+3)&(0xffffffff-3);
-
-   void *mem = malloc_block_alloc(&malloc_bmanage,size);
+   mem = NULL;
+   if(size<=INT32_MAX)
+   {
+      mem = malloc_block_alloc(&malloc_bmanage,size);
+      if(mem==NULL&&malloc_region_grow(&malloc_bmanage,size))
+         mem = malloc_block_alloc(&malloc_bmanage,size);
+   }
+   malloc_unlock();
    if(mem!=NULL) 
       return mem;
 
-   //TODO: try to free some unnecessary allocations in this case
-   //      free currently unused textures?
+   mem = malloc_evict_retry(size);
+   if(mem!=NULL)
+      return mem;
+
    RvR_log("RvR_malloc: Allocation of size %zu failed, out of memory\n",size);
    RvR_malloc_report();
 
    return NULL;
 }
 
-void *RvR_malloc_base()
-{
-   return malloc_bmanage.addr;
-}
-
-void RvR_free(void *ptr)
+static void malloc_release(void *ptr)
 {
    if(!malloc_bmanage_total) 
    { 
@@ -130,22 +674,32 @@ void RvR_free(void *ptr)
       return ; 
    }
 
-   if(ptr>=(void *)malloc_bmanage.sfirst)  //is the pointer in this block?
+   if(malloc_cache_put(ptr))
+      return;
+
+   malloc_lock();
+   int valid = malloc_region_find(malloc_bmanage.regions,malloc_bmanage.region_count,ptr)>=0;
+   if(valid)
+      malloc_block_free(&malloc_bmanage,ptr);
+
+#ifdef MALLOC_THREAD_LOCAL
+   if(malloc_threaded&&malloc_cache.region_generation!=malloc_bmanage.region_generation)
    {
-      if(ptr<=(void *)malloc_bmanage.slast)  //is it in static space?
-      {
-         malloc_block_free(&malloc_bmanage,ptr);
-         return ;
-      } 
+      malloc_cache.region_count = malloc_bmanage.region_count;
+      malloc_cache.region_generation = malloc_bmanage.region_generation;
+      memcpy(malloc_cache.regions,malloc_bmanage.regions,sizeof(*malloc_cache.regions)*malloc_bmanage.region_count);
    }
+#endif
+   malloc_unlock();
 
-   RvR_log("RvR_malloc: free() bad pointer\n");
+   if(!valid)
+      RvR_log("RvR_malloc: free() bad pointer\n");
 }
 
-void *RvR_realloc(void *ptr, size_t size)
+static void *malloc_resize(void *ptr, size_t size)
 {
    if(ptr==NULL) 
-      return RvR_malloc(size);
+      return malloc_alloc(size);
 
    if(!malloc_bmanage_total) 
    {
@@ -155,137 +709,645 @@ void *RvR_realloc(void *ptr, size_t size)
 
    if(size==0) 
    { 
-      RvR_free(ptr); 
+      malloc_release(ptr); 
       return NULL; 
    }
 
+   if(size>INT32_MAX)
+   {
+      RvR_log("RvR_malloc: Reallocation to size %zu failed, too large\n",size);
+      return NULL;
+   }
+
    int32_t old_size = 0;
-   if(ptr>=(void *)malloc_bmanage.sfirst && 
-      ptr<=(void *)(((char *)malloc_bmanage.sfirst)+malloc_bmanage.block_size))
+   malloc_lock();
+   int valid = malloc_region_find(malloc_bmanage.regions,malloc_bmanage.region_count,ptr)>=0;
+   malloc_unlock();
+   if(valid)
    {
       old_size = malloc_block_pointer_size(ptr);  
 
-      if(ptr<=(void *)malloc_bmanage.slast)
-      {
-         void *nptr = RvR_malloc(size);
-         if((int32_t)size>old_size)
-            memcpy(nptr,ptr,old_size);
-         else
-            memcpy(nptr,ptr,size);
+      //Shrink or grow into the following free block if possible
+      size_t rsize = malloc_size_round(size);
+      malloc_lock();
+      int resized = rsize<=INT32_MAX&&malloc_block_resize(&malloc_bmanage,ptr,rsize);
+      malloc_unlock();
+      if(resized)
+         return ptr;
 
-         malloc_block_free(&malloc_bmanage,ptr);
+      void *nptr = malloc_alloc(size);
+      if(nptr==NULL)
+         return NULL;
+      if((int32_t)size>old_size)
+         memcpy(nptr,ptr,old_size);
+      else
+         memcpy(nptr,ptr,size);
 
-         return nptr;
-      }
+      malloc_release(ptr);
+
+      return nptr;
    }
 
    RvR_log("RvR_malloc: realloc() bad pointer\n");
    return NULL;
 }
 
-void RvR_malloc_report()
+//Sentinels at both ends of a region (a footer and a header of size 0)
+//keep blocks from merging across regions, so the neighbours of a block
+//can be found without knowing its region
+static int malloc_region_add(Malloc_block_manager *b, void *mem, size_t bytes)
 {
-   if(!malloc_bmanage_total)
+   if(b->region_count==MALLOC_REGIONS_MAX)
+      return 0;
+
+   //Headers sit right before the payload, place the
+   //first one so that all payloads are aligned
+   char *start = mem;
+   uintptr_t misalign = ((uintptr_t)start+2*MALLOC_TAG)&(MALLOC_ALIGN-1);
+   if(misalign)
+      start+=MALLOC_ALIGN-misalign;
+
+   size_t overhead = (size_t)(start-(char *)mem)+2*MALLOC_TAG+MALLOC_OVERHEAD;
+   if(bytes<overhead+MALLOC_MIN_SIZE)
+      return 0;
+   int32_t size = (int32_t)((bytes-overhead)&~(size_t)(MALLOC_ALIGN-1));
+
+   *((int32_t *)start) = 0;
+   Malloc_memory_node *first = (Malloc_memory_node *)(start+MALLOC_TAG);
+   malloc_node_set(first,-size);
+   Malloc_memory_node *end = (Malloc_memory_node *)(MALLOC_FOOTER(first,size)+1);
+   end->size = 0;
+   malloc_free_insert(b,first);
+
+   int i = b->region_count;
+   for(;i>0&&b->regions[i-1].first>first;i--)
+      b->regions[i] = b->regions[i-1];
+   b->regions[i].mem = mem;
+   b->regions[i].bytes = bytes;
+   b->regions[i].first = first;
+   b->regions[i].end = (char *)end;
+   b->regions[i].size = size;
+   b->region_count++;
+   b->region_generation++;
+   b->total+=bytes;
+
+   return 1;
+}
+
+//Adds a region large enough for an allocation of size bytes
+static int malloc_region_grow(Malloc_block_manager *b, int32_t size)
+{
+   //malloc_free_find() rounds up to the next list boundary
+   size_t bytes = (size_t)size+size/MALLOC_SL_COUNT+MALLOC_OVERHEAD+2*MALLOC_TAG+2*MALLOC_ALIGN;
+   bytes = RvR_max((size_t)RVR_MALLOC_GROW,bytes);
+   if(RVR_MALLOC_GROW==0||bytes>MALLOC_REGION_MAX||b->region_count==MALLOC_REGIONS_MAX)
+      return 0;
+
+   void *mem = malloc(bytes);
+   if(mem==NULL)
+      return 0;
+   if(!malloc_region_add(b,mem,bytes))
    {
-      RvR_log("RvR_malloc: using system allocator, memory report not possible\n");
-      return;
+      free(mem);
+      return 0;
    }
 
-   malloc_block_report(&malloc_bmanage);
+   RvR_log("RvR_malloc: added region of %zu bytes, %zu bytes total\n",bytes,b->total);
+
+   return 1;
 }
 
-static void malloc_block_init(Malloc_block_manager *b, void *block, long block_size)
+//Index of the region containing ptr, -1 if none
+static int malloc_region_find(const Malloc_region *regions, int count, const void *ptr)
 {
-   b->block_size = block_size;
-   b->addr = block;
+   const char *p = ptr;
+   int low = 0;
+   int high = count-1;
 
-   b->sfirst = (Malloc_memory_node *)(((char *)block));   
-   b->slast = b->sfirst;
-   b->sfirst->size = -(block_size-(int32_t)sizeof(Malloc_memory_node));
-   b->sfirst->next = NULL;
+   while(low<=high)
+   {
+      int mid = (low+high)/2;
+      if(p<=(const char *)regions[mid].first)
+         high = mid-1;
+      else if(p>=regions[mid].end)
+         low = mid+1;
+      else
+         return mid;
+   }
+
+   return -1;
 }
 
 static void *malloc_block_alloc(Malloc_block_manager *b, int32_t size)
 {
-   Malloc_memory_node *s = b->sfirst;
-   if(s==NULL) 
-      return NULL;
-   for(;s&&-s->size<size;s = s->next);
+   Malloc_memory_node *s = malloc_free_find(b,size);
    if(s==NULL)
       return NULL;
-   s->size = -s->size;
-
-   if(s->size-size>(int32_t)sizeof(Malloc_memory_node)+4)  //is there enough space to split the block?
-   {    
-      Malloc_memory_node *p = (Malloc_memory_node *)((char *)s+sizeof(Malloc_memory_node)+size);
-      if(s==b->slast)
-         b->slast = p;
-      p->size = -(s->size-size-(int32_t)sizeof(Malloc_memory_node));
-      p->next=s->next;
-      s->next=p;
-      s->size=size;
-   }
+   malloc_free_remove(b,s);
+   malloc_node_set(s,-s->size);
+   malloc_node_split(b,s,size);
 
-   return (void *)(((char *)s)+sizeof(Malloc_memory_node));
+   return (void *)(((char *)s)+MALLOC_TAG);
 }
 
 static void malloc_block_free(Malloc_block_manager *b, void *ptr)
 {
-   Malloc_memory_node *o = (Malloc_memory_node *)(((char *)ptr)-sizeof(Malloc_memory_node)),*last = NULL;
+   Malloc_memory_node *o = (Malloc_memory_node *)(((char *)ptr)-MALLOC_TAG);
+   int32_t size = o->size;
 
-   if(o->next&&o->next->size<0)   //see if we can add into next block
+   //see if we can add into next block
+   Malloc_memory_node *next = malloc_node_next(o);
+   if(next!=NULL&&next->size<0)
    {
-      if(o->next==b->slast)
-         b->slast = o;
-      o->size+=-o->next->size+sizeof(Malloc_memory_node);
-      o->next = o->next->next;
+      malloc_free_remove(b,next);
+      size+=-next->size+MALLOC_OVERHEAD;
    }
 
-   Malloc_memory_node *n = b->sfirst;
-   for(;n&&n!=o;n=n->next)
-      last = n;
-
-   if(last&&last->size<0)
+   //or into the previous one
+   Malloc_memory_node *prev = malloc_node_prev(o);
+   if(prev!=NULL&&prev->size<0)
    {
-      if(o==b->slast)
-         b->slast = last;
-      last->next=o->next;
-      last->size-=o->size+sizeof(Malloc_memory_node);	
+      malloc_free_remove(b,prev);
+      size+=-prev->size+MALLOC_OVERHEAD;
+      o = prev;
    }
-   else
+
+   malloc_node_set(o,-size);
+   malloc_free_insert(b,o);
+}
+
+//Resizes in place, size must already be rounded
+//Returns 0 if the block can't grow without moving
+static int malloc_block_resize(Malloc_block_manager *b, void *ptr, int32_t size)
+{
+   Malloc_memory_node *o = (Malloc_memory_node *)(((char *)ptr)-MALLOC_TAG);
+
+   if(size>o->size)
    {
-      o->size=-o->size;            
+      Malloc_memory_node *next = malloc_node_next(o);
+      if(next==NULL||next->size>=0||o->size+MALLOC_OVERHEAD-next->size<size)
+         return 0;
+
+      malloc_free_remove(b,next);
+      malloc_node_set(o,o->size+MALLOC_OVERHEAD-next->size);
    }
+
+   malloc_node_split(b,o,size);
+
+   return 1;
 }
 
 static long malloc_block_pointer_size(void *ptr)
 {
-   return ((Malloc_memory_node *)(((char *)ptr)-sizeof(Malloc_memory_node)))->size;
+   return ((Malloc_memory_node *)(((char *)ptr)-MALLOC_TAG))->size;
 }
 
 static void malloc_block_report(Malloc_block_manager *b)
 {
-   RvR_log("************** Block size = %d ***************\n",b->block_size);
-   RvR_log("Index\tBase\t\t(Offset)\t      Size\n");
-   int i = 0;
-   Malloc_memory_node * f = b->sfirst;
-   int32_t f_total = 0, a_total = 0;
+   int64_t f_total = 0, a_total = 0;
+   int32_t f_max = 0;
 
-   for(;f;f = f->next,i++)
+   for(int r = 0;r<b->region_count;r++)
    {
-      RvR_log("%4d\t%p\t(%10ld)\t%10d",i,f,((char *)f-(char *)b->sfirst),f->size);
-      if(f->size>0)
+      Malloc_region *region = &b->regions[r];
+      RvR_log("************** Region %d, size = %zu ***************\n",r,region->bytes);
+      RvR_log("Index\tBase\t\t(Offset)\t      Size\n");
+      int i = 0;
+      Malloc_memory_node * f = region->first;
+
+      for(;f;f = malloc_node_next(f),i++)
       {
-         a_total+=f->size;
+         RvR_log("%4d\t%p\t(%10ld)\t%10d",i,f,(long)((char *)f-(char *)region->first),f->size);
+         if(f->size>0)
+         {
+            a_total+=f->size;
+         }
+         else
+         {
+            f_total+=-f->size;
+            f_max = RvR_max(f_max,-f->size);
+         }
+
+         RvR_log("\n");
       }
-      else
+   }
+
+   RvR_log("**************** Block summary : %lld free, %lld allocated, %d regions\n",(long long)f_total,(long long)a_total,b->region_count);
+   if(f_total>0)
+      RvR_log("**************** Largest free block : %d, fragmentation %d%%\n",f_max,(int)(100-((int64_t)f_max*100)/f_total));
+}
+
+static size_t malloc_size_round(size_t size)
+{
+   size = (size+MALLOC_ALIGN-1)&~(size_t)(MALLOC_ALIGN-1);
+   if(size<(size_t)MALLOC_MIN_SIZE)
+      size = MALLOC_MIN_SIZE;
+
+   return size;
+}
+
+//Writes header and footer
+static void malloc_node_set(Malloc_memory_node *n, int32_t size)
+{
+   n->size = size;
+   *MALLOC_FOOTER(n,size<0?-size:size) = size;
+}
+
+//Returns NULL at the end of a region
+static Malloc_memory_node *malloc_node_next(Malloc_memory_node *n)
+{
+   Malloc_memory_node *next = (Malloc_memory_node *)(MALLOC_FOOTER(n,n->size<0?-n->size:n->size)+1);
+   if(next->size==0)
+      return NULL;
+
+   return next;
+}
+
+//The footer of the previous block sits right before the header
+static Malloc_memory_node *malloc_node_prev(Malloc_memory_node *n)
+{
+   int32_t size = ((int32_t *)n)[-1];
+   if(size==0)
+      return NULL;
+
+   return (Malloc_memory_node *)((char *)n-(size<0?-size:size)-MALLOC_OVERHEAD);
+}
+
+//Splits the used block n after size bytes, if the rest
+//is large enough to form a block of its own
+static void malloc_node_split(Malloc_block_manager *b, Malloc_memory_node *n, int32_t size)
+{
+   int32_t rest = n->size-size-MALLOC_OVERHEAD;
+   if(rest<MALLOC_MIN_SIZE)
+      return;
+
+   malloc_node_set(n,size);
+   Malloc_memory_node *p = (Malloc_memory_node *)(MALLOC_FOOTER(n,size)+1);
+   malloc_node_set(p,rest);
+
+   //The rest might border another free block when shrinking
+   Malloc_memory_node *next = malloc_node_next(p);
+   if(next!=NULL&&next->size<0)
+   {
+      malloc_free_remove(b,next);
+      rest+=-next->size+MALLOC_OVERHEAD;
+   }
+
+   malloc_node_set(p,-rest);
+   malloc_free_insert(b,p);
+}
+
+static void malloc_mapping(int32_t size, int *fl, int *sl)
+{
+   if(size<MALLOC_SMALL)
+   {
+      *fl = 0;
+      *sl = size/(MALLOC_SMALL/MALLOC_SL_COUNT);
+      return;
+   }
+
+   int f = malloc_fls(size);
+   *sl = (size>>(f-MALLOC_SL_LOG))^MALLOC_SL_COUNT;
+   *fl = f-(MALLOC_FL_SHIFT-1);
+}
+
+//Free block size is stored negated
+static void malloc_free_insert(Malloc_block_manager *b, Malloc_memory_node *n)
+{
+   int fl,sl;
+   malloc_mapping(-n->size,&fl,&sl);
+
+   Malloc_free_links *links = MALLOC_LINKS(n);
+   links->prev = NULL;
+   links->next = b->free[fl][sl];
+   if(links->next!=NULL)
+      MALLOC_LINKS(links->next)->prev = n;
+   b->free[fl][sl] = n;
+
+   b->fl_bitmap|=1u<<fl;
+   b->sl_bitmap[fl]|=1u<<sl;
+}
+
+static void malloc_free_remove(Malloc_block_manager *b, Malloc_memory_node *n)
+{
+   int fl,sl;
+   malloc_mapping(-n->size,&fl,&sl);
+
+   Malloc_free_links *links = MALLOC_LINKS(n);
+   if(links->next!=NULL)
+      MALLOC_LINKS(links->next)->prev = links->prev;
+   if(links->prev!=NULL)
+   {
+      MALLOC_LINKS(links->prev)->next = links->next;
+      return;
+   }
+
+   b->free[fl][sl] = links->next;
+   if(links->next==NULL)
+   {
+      b->sl_bitmap[fl]&=~(1u<<sl);
+      if(b->sl_bitmap[fl]==0)
+         b->fl_bitmap&=~(1u<<fl);
+   }
+}
+
+//Any block in the returned list is large enough, since the
+//size gets rounded up to the next list boundary first
+static Malloc_memory_node *malloc_free_find(Malloc_block_manager *b, int32_t size)
+{
+   if(size>=MALLOC_SMALL)
+   {
+      int32_t round = (1<<(malloc_fls(size)-MALLOC_SL_LOG))-1;
+      if(size>INT32_MAX-round)
+         return NULL;
+      size+=round;
+   }
+
+   int fl,sl;
+   malloc_mapping(size,&fl,&sl);
+   if(fl>=MALLOC_FL_COUNT)
+      return NULL;
+
+   uint32_t sl_map = b->sl_bitmap[fl]&(~0u<<sl);
+   if(sl_map==0)
+   {
+      uint32_t fl_map = fl+1<32?b->fl_bitmap&(~0u<<(fl+1)):0;
+      if(fl_map==0)
+         return NULL;
+
+      fl = malloc_ffs(fl_map);
+      sl_map = b->sl_bitmap[fl];
+   }
+   sl = malloc_ffs(sl_map);
+
+   return b->free[fl][sl];
+}
+
+//Runs the eviction callbacks, retrying the allocation after each call.
+//The engine caches aren't thread safe, so only the thread that
+//called RvR_malloc_init() evicts. Size must already be rounded
+static void *malloc_evict_retry(size_t size)
+{
+#ifdef MALLOC_THREAD_LOCAL
+   if(!malloc_main_thread)
+      return NULL;
+#else
+   if(malloc_threaded)
+      return NULL;
+#endif
+
+   //Callbacks might allocate themselves
+   if(malloc_evicting||size>INT32_MAX)
+      return NULL;
+   malloc_evicting = 1;
+   malloc_evict_runs++;
+
+   //Blocks cached by this thread count as used
+   RvR_malloc_thread_flush();
+
+   malloc_lock();
+   void *mem = malloc_block_alloc(&malloc_bmanage,size);
+   malloc_unlock();
+
+   for(int i = 0;i<malloc_evict_count&&mem==NULL;i++)
+   {
+      Malloc_evict *e = &malloc_evict[i];
+      size_t released;
+
+      do
       {
-         f_total+=-f->size;
+         released = e->func(size);
+         e->calls++;
+         e->released+=released;
+
+         malloc_lock();
+         mem = malloc_block_alloc(&malloc_bmanage,size);
+         malloc_unlock();
+      }while(mem==NULL&&released>0);
+   }
+
+   if(mem!=NULL)
+      malloc_evict_recovered++;
+   malloc_evicting = 0;
+
+   return mem;
+}
+
+//Size must already be rounded
+static void *malloc_cache_get(size_t size)
+{
+#ifdef MALLOC_THREAD_LOCAL
+   if(!malloc_threaded||size>MALLOC_CACHE_SIZE)
+      return NULL;
+
+   int class = size/MALLOC_ALIGN;
+   Malloc_cached *c = malloc_cache.blocks[class];
+   if(c==NULL)
+      return NULL;
+
+   malloc_cache.blocks[class] = c->next;
+   malloc_cache.count[class]--;
+
+   return c;
+#else
+   (void)size;
+   return NULL;
+#endif
+}
+
+//Cached blocks stay marked as used in the heap
+static int malloc_cache_put(void *ptr)
+{
+#ifdef MALLOC_THREAD_LOCAL
+   if(!malloc_threaded)
+      return 0;
+
+   //A region released by RvR_malloc_trim() might still be in the copy,
+   //freeing into it is a use after free anyway
+   if(malloc_region_find(malloc_cache.regions,malloc_cache.region_count,ptr)<0)
+      return 0;
+
+   int32_t size = malloc_block_pointer_size(ptr);
+   if(size>MALLOC_CACHE_SIZE)
+      return 0;
+
+   int class = size/MALLOC_ALIGN;
+   if(malloc_cache.count[class]>=MALLOC_CACHE_MAX)
+      return 0;
+
+   Malloc_cached *c = ptr;
+   c->next = malloc_cache.blocks[class];
+   malloc_cache.blocks[class] = c;
+   malloc_cache.count[class]++;
+
+   return 1;
+#else
+   (void)ptr;
+   return 0;
+#endif
+}
+
+static void malloc_lock()
+{
+   if(malloc_threaded)
+      RvR_backend_mutex_lock(malloc_mutex);
+}
+
+static void malloc_unlock()
+{
+   if(malloc_threaded)
+      RvR_backend_mutex_unlock(malloc_mutex);
+}
+
+//Index of highest set bit, v must not be 0
+static int malloc_fls(uint32_t v)
+{
+#if defined(__GNUC__)
+   return 31-__builtin_clz(v);
+#else
+   int bit = 0;
+   while(v>>=1)
+      bit++;
+   return bit;
+#endif
+}
+
+//Index of lowest set bit, v must not be 0
+static int malloc_ffs(uint32_t v)
+{
+#if defined(__GNUC__)
+   return __builtin_ctz(v);
+#else
+   int bit = 0;
+   while(!(v&1))
+   {
+      v>>=1;
+      bit++;
+   }
+   return bit;
+#endif
+}
+
+#if RVR_MALLOC_PROFILE
+
+//Index into profile_sites, sites get hashed by file name and line,
+//once the table is full, new sites get counted as one "other" site
+static uint32_t malloc_profile_site(const char *file, int line)
+{
+   uint32_t hash = RvR_fnv32a_buf(&line,sizeof(line),RvR_fnv32a(file));
+   uint32_t index = RVR_MALLOC_PROFILE_SITES;
+
+   malloc_lock();
+   for(int i = 0;i<RVR_MALLOC_PROFILE_SITES;i++)
+   {
+      uint32_t slot = (hash+i)&(RVR_MALLOC_PROFILE_SITES-1);
+      Malloc_profile_site *s = &profile_sites[slot];
+
+      if(s->file==NULL)
+      {
+         s->file = file;
+         s->line = line;
+         index = slot;
+         break;
+      }
+
+      if(s->line==line&&(s->file==file||strcmp(s->file,file)==0))
+      {
+         index = slot;
+         break;
       }
+   }
 
-      RvR_log("\n");
+   if(index==RVR_MALLOC_PROFILE_SITES)
+   {
+      profile_sites[index].file = "other";
+      profile_sites[index].line = 0;
    }
+   malloc_unlock();
 
-   RvR_log("**************** Block summary : %d free, %d allocated\n",f_total,a_total);
+   return index;
 }
+
+//Checks the block before its header gets read,
+//RvR_free() leaves reporting bad pointers to malloc_release()
+static int malloc_profile_valid(const Malloc_profile_header *h)
+{
+   if(malloc_bmanage_total)
+   {
+      malloc_lock();
+      int valid = malloc_region_find(malloc_bmanage.regions,malloc_bmanage.region_count,h)>=0;
+      malloc_unlock();
+      if(!valid)
+         return 0;
+   }
+
+   return h->site<=RVR_MALLOC_PROFILE_SITES;
+}
+
+static void malloc_profile_alloc(Malloc_profile_header *h, size_t size, uint32_t site)
+{
+   h->site = site;
+   h->frame = RvR_core_frame();
+   h->size = size;
+
+   malloc_lock();
+   Malloc_profile_site *s = &profile_sites[site];
+   s->allocs++;
+   s->frame_allocs++;
+   s->bytes+=size;
+   s->live+=size;
+   s->live_peak = RvR_max(s->live_peak,s->live);
+
+   profile_live+=size;
+   profile_live_peak = RvR_max(profile_live_peak,profile_live);
+   profile_frame_allocs++;
+   profile_frame_bytes+=size;
+   malloc_unlock();
+}
+
+static void malloc_profile_free(const Malloc_profile_header *h)
+{
+   uint32_t lifetime = RvR_core_frame()-h->frame;
+   int bucket = lifetime==0?0:RvR_min(MALLOC_PROFILE_LIFETIMES-1,malloc_fls(lifetime)+1);
+
+   malloc_lock();
+   Malloc_profile_site *s = &profile_sites[h->site];
+   s->frees++;
+   s->live-=h->size;
+   s->lifetime[bucket]++;
+
+   profile_live-=h->size;
+   malloc_unlock();
+}
+
+//Like a free followed by an allocation, but
+//not counted in the lifetime histogram
+static void malloc_profile_resize(Malloc_profile_header *h, const Malloc_profile_header *old, size_t size, uint32_t site)
+{
+   malloc_lock();
+   Malloc_profile_site *s = &profile_sites[old->site];
+   s->frees++;
+   s->live-=old->size;
+
+   profile_live-=old->size;
+   malloc_unlock();
+
+   malloc_profile_alloc(h,size,site);
+   h->frame = old->frame;
+}
+
+static int malloc_profile_compare(const void *a, const void *b)
+{
+   const Malloc_profile_site *sa = &profile_sites[*((const int *)a)];
+   const Malloc_profile_site *sb = &profile_sites[*((const int *)b)];
+
+   if(sa->bytes!=sb->bytes)
+      return sa->bytes<sb->bytes?1:-1;
+   if(sa->allocs!=sb->allocs)
+      return sa->allocs<sb->allocs?1:-1;
+
+   return 0;
+}
+
+#endif
 //-------------------------------------
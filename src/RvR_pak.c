@@ -46,6 +46,9 @@ typedef struct
    uint32_t path;
 }Pak_lump;
 
+//Lump name (zero padded to 8 chars) -> index into pak_paths
+RvR_map_type(uint64_t,uint32_t,pak_map_lump);
+
 typedef struct Pak_buffer
 {
    char path[256];
@@ -55,12 +58,7 @@ typedef struct Pak_buffer
 //-------------------------------------
 
 //Variables
-static struct
-{
-   uint32_t used;
-   uint32_t size;
-   Pak_lump *data;
-}pak_lumps[256] = {0};
+static pak_map_lump pak_lumps = {0};
 
 static struct
 {
@@ -70,13 +68,18 @@ static struct
 }pak_paths;
 
 static Pak_buffer *pak_buffer = NULL;
+
+//Set while a pak buffer is in use, so it doesn't get evicted
+static int pak_busy = 0;
 //-------------------------------------
 
 //Function prototypes
 static void     pak_lumps_push(Pak_lump l);
 static uint32_t pak_paths_push(const char *path);
+static uint64_t pak_lump_key(const char *name);
 static void     pak_add_csv(const char *path);
 static void     pak_add_pak(const char *path);
+static size_t   pak_evict(size_t size);
 
 //cute_path
 static int pak_path_pop_ext(const char *path, char *out, char *ext);
@@ -92,6 +95,8 @@ static void    *pak_extract(Pak *p, unsigned index);
 static int      pak_find(Pak *p, const char *filename);
 static Pak     *pak_open(const char *fname, const char *mode);
 static void     pak_append_file(Pak *p, const char *filename, FILE *in);
+
+RvR_map_function_prototype(uint64_t,uint32_t,pak_map_lump,static inline);
 //-------------------------------------
 
 //Function implementations
@@ -221,57 +226,58 @@ void *RvR_lump_get(const char *name, unsigned *size)
 {
    RvR_error_check(name!=NULL,"RvR_lump_get","argument 'name' must be non-NULL\n");
 
-   char name8[8];
-   strncpy(name8,name,8);
-   uint8_t lump_index = RvR_fnv32a_buf(name8,8,RVR_FNV32A_INIT); //Would xor folding be better?
-
-   for(uint32_t i = 0;i<pak_lumps[lump_index].used;i++)
+   const uint32_t *lump = pak_map_lump_get(&pak_lumps,pak_lump_key(name));
+   if(lump!=NULL)
    {
-      if(strncmp(name,pak_lumps[lump_index].data[i].name,8)==0)
+      const char *path = pak_paths.data[*lump];
+
+      //Check for pak file
+      char ext[CUTE_PATH_MAX_EXT] = {0};
+      pak_path_pop_ext(path,NULL,ext);
+      if(strncmp(ext,"pak",CUTE_PATH_MAX_EXT)==0)
       {
-         //Check for pak file
-         char ext[CUTE_PATH_MAX_EXT] = {0};
-         pak_path_pop_ext(pak_paths.data[pak_lumps[lump_index].data[i].path],NULL,ext);
-         if(strncmp(ext,"pak",CUTE_PATH_MAX_EXT)==0)
+         //Check if pak already opened
+         pak_busy = 1;
+         Pak_buffer *b = pak_buffer;
+         while(b)
          {
-            //Check if pak already opened
-            Pak_buffer *b = pak_buffer;
-            while(b)
-            {
-               if(strcmp(b->path,pak_paths.data[pak_lumps[lump_index].data[i].path])==0)
-                  break;
-               b = b->next;
-            }
-            if(b==NULL)
-            {
-               b = RvR_malloc(sizeof(*b));
-               b->pak = pak_open(pak_paths.data[pak_lumps[lump_index].data[i].path],"r");
-               strncpy(b->path,pak_paths.data[pak_lumps[lump_index].data[i].path],255);
-               b->path[255] = '\0';
-               b->next = pak_buffer;
-               pak_buffer = b;
-            }
-
-            int index = pak_find(b->pak,name);
-            if(size!=NULL)
-               *size = pak_size(b->pak,index);
-            return pak_extract(b->pak,index);
+            if(strcmp(b->path,path)==0)
+               break;
+            b = b->next;
+         }
+         if(b==NULL)
+         {
+            b = RvR_malloc(sizeof(*b));
+            b->pak = pak_open(path,"r");
+            strncpy(b->path,path,255);
+            b->path[255] = '\0';
+            b->next = pak_buffer;
+            pak_buffer = b;
+            RvR_malloc_evict_register(pak_evict,10,"pak files");
          }
 
-         //Raw reading
-         FILE *f = fopen(pak_paths.data[pak_lumps[lump_index].data[i].path],"rb");
-         RvR_error_check(f!=NULL,"RvR_lump_get","failed to open '%s'\n",pak_paths.data[pak_lumps[lump_index].data[i].path]);
-         fseek(f,0,SEEK_END);
-         unsigned fsize = ftell(f);
+         int index = pak_find(b->pak,name);
          if(size!=NULL)
-            *size = fsize;
-         fseek(f,0,SEEK_SET);
-         uint8_t *buffer = RvR_malloc(fsize+1);
-         fread(buffer,fsize,1,f);
-         buffer[fsize] = 0;
-         fclose(f);
-         return buffer;
+            *size = pak_size(b->pak,index);
+         void *data = pak_extract(b->pak,index);
+         pak_busy = 0;
+
+         return data;
       }
+
+      //Raw reading
+      FILE *f = fopen(path,"rb");
+      RvR_error_check(f!=NULL,"RvR_lump_get","failed to open '%s'\n",path);
+      fseek(f,0,SEEK_END);
+      unsigned fsize = ftell(f);
+      if(size!=NULL)
+         *size = fsize;
+      fseek(f,0,SEEK_SET);
+      uint8_t *buffer = RvR_malloc(fsize+1);
+      fread(buffer,fsize,1,f);
+      buffer[fsize] = 0;
+      fclose(f);
+      return buffer;
    }
 
    RvR_log_line("RvR_lump_get","lump '%s' not found\n",name);
@@ -286,13 +292,9 @@ const char *RvR_lump_get_path(const char *name)
 {
    RvR_error_check(name!=NULL,"RvR_lump_get_path","argument 'name' must be non-NULL\n");
 
-   char name8[8];
-   strncpy(name8,name,8);
-   uint8_t lump_index = RvR_fnv32a_buf(name8,8,RVR_FNV32A_INIT); //Would xor folding be better?
-
-   for(int i = pak_lumps[lump_index].used-1;i>=0;i--)
-      if(strncmp(name,pak_lumps[lump_index].data[i].name,8)==0)
-         return pak_paths.data[pak_lumps[lump_index].data[i].path];
+   const uint32_t *lump = pak_map_lump_get(&pak_lumps,pak_lump_key(name));
+   if(lump!=NULL)
+      return pak_paths.data[*lump];
 
    RvR_log("RvR_pak: lump %s not found\n",name);
 
@@ -304,13 +306,7 @@ int RvR_lump_exists(const char *name)
 {
    RvR_error_check(name!=NULL,"RvR_lump_exists","argument 'name' must be non-NULL\n");
 
-   char name8[8];
-   strncpy(name8,name,8);
-   uint8_t lump_index = RvR_fnv32a_buf(name8,8,RVR_FNV32A_INIT); //Would xor folding be better?
-
-   for(int i = pak_lumps[lump_index].used-1;i>=0;i--)
-      if(strncmp(name,pak_lumps[lump_index].data[i].name,8)==0)
-         return 1;
+   return pak_map_lump_get(&pak_lumps,pak_lump_key(name))!=NULL;
 
 RvR_err:
    return 0;
@@ -378,6 +374,7 @@ static void pak_add_pak(const char *path)
    RvR_error_check(path!=NULL,"pak_add_pak","argument 'path' must be non-NULL\n");
 
    //Add pak to list
+   pak_busy = 1;
    Pak_buffer *b = RvR_malloc(sizeof(*b));
    b->pak = pak_open(path,"r");
    strncpy(b->path,path,255);
@@ -389,42 +386,50 @@ static void pak_add_pak(const char *path)
    int count = pak_count(b->pak);
    for(int i = 0;i<count;i++)
       RvR_lump_add(pak_name(b->pak,i),path);
+   pak_busy = 0;
+   RvR_malloc_evict_register(pak_evict,10,"pak files");
 
 RvR_err:
    return;
 }
 
-//Add a lump to the lump array.
-//Array will dynamically expand if more 
-//space is needed
-static void pak_lumps_push(Pak_lump l)
+//Closes all pak files, they get reopened on demand
+static size_t pak_evict(size_t size)
 {
-   uint8_t lump_index = RvR_fnv32a_buf(l.name,8,RVR_FNV32A_INIT); //Would xor folding be better?
+   (void)size;
 
-   //Allocate memory for list
-   if(pak_lumps[lump_index].data==NULL)
-   {
-      pak_lumps[lump_index].size = 4;
-      pak_lumps[lump_index].used = 0;
-      pak_lumps[lump_index].data = RvR_malloc(sizeof(*pak_lumps[lump_index].data)*pak_lumps[lump_index].size);
-   }
-  
-   //Override existing entry
-   for(uint32_t i = 0;i<pak_lumps[lump_index].used;i++)
-   {
-      if(strncmp(pak_lumps[lump_index].data[i].name,l.name,8)==0)
-      {
-         memcpy(&pak_lumps[lump_index].data[i],&l,sizeof(l));
-         return;
-      }
-   }
+   if(pak_busy||pak_buffer==NULL)
+      return 0;
 
-   pak_lumps[lump_index].data[pak_lumps[lump_index].used++] = l;
-   if(pak_lumps[lump_index].used==pak_lumps[lump_index].size)
+   size_t released = 0;
+   for(Pak_buffer *b = pak_buffer;b!=NULL;b = b->next)
    {
-      pak_lumps[lump_index].size*=2;
-      pak_lumps[lump_index].data = RvR_realloc(pak_lumps[lump_index].data,sizeof(*pak_lumps[lump_index].data)*pak_lumps[lump_index].size);
+      released+=sizeof(*b);
+      if(b->pak!=NULL)
+         released+=sizeof(*b->pak)+sizeof(*b->pak->in)+sizeof(*b->pak->entries)*b->pak->count;
    }
+   RvR_pak_flush();
+
+   return released;
+}
+
+//Add a lump to the lump map,
+//overrides an existing entry with the same name
+static void pak_lumps_push(Pak_lump l)
+{
+   pak_map_lump_set(&pak_lumps,pak_lump_key(l.name),l.path);
+}
+
+//Packs the name into a map key, only the first 8 chars are significant
+static uint64_t pak_lump_key(const char *name)
+{
+   char name8[8] = {0};
+   strncpy(name8,name,8);
+
+   uint64_t key;
+   memcpy(&key,name8,sizeof(key));
+
+   return key;
 }
 
 static uint32_t pak_paths_push(const char *path)
@@ -879,6 +884,8 @@ RvR_err:
 }
 
 //pak.c END
+
+RvR_map_function(uint64_t,uint32_t,pak_map_lump,RvR_map_hash_u64,RvR_map_equal_u64,256,static inline)
 //-------------------------------------
 
 #undef CUTE_PATH_MAX_PATH
@@ -32,6 +32,8 @@ static RvR_color *palette = NULL;
 
 //Function prototypes
 static void pal_calculate_colormap();
+static void pal_shade_rows(void *data, int start, int end);
+static void pal_trans_rows(void *data, int start, int end);
 
 static uint8_t pal_find_closest(int r, int g, int b);
 //-------------------------------------
@@ -79,17 +81,22 @@ static void pal_calculate_colormap()
    if(shade_table==NULL)
       shade_table = RvR_malloc(sizeof(*shade_table)*256*64);
 
-   //Distance fading
-   for(int x = 0;x<256;x++)
+   //Every entry searches the whole palette, split across the job system
+   RvR_job_parallel_for(pal_shade_rows,NULL,64,4);
+   RvR_job_parallel_for(pal_trans_rows,NULL,256,8);
+}
+
+//Distance fading
+static void pal_shade_rows(void *data, int start, int end)
+{
+   (void)data;
+
+   for(int y = start;y<end;y++)
    {
-      for(int y = 0;y<64;y++)
-      {
-         if(x==0)
-         {
-            shade_table[y*256+x] = 0;
-            continue;
-         }
+      shade_table[y*256] = 0;
 
+      for(int x = 1;x<256;x++)
+      {
          int r = RvR_max(0,RvR_min(255,((int)palette[x].r*(63-y))/63));
          int g = RvR_max(0,RvR_min(255,((int)palette[x].g*(63-y))/63));
          int b = RvR_max(0,RvR_min(255,((int)palette[x].b*(63-y))/63));
@@ -97,9 +104,14 @@ static void pal_calculate_colormap()
          shade_table[y*256+x] = pal_find_closest(r,g,b);
       }
    }
+}
 
-   //Transparancy
-   for(int i = 0;i<256;i++)
+//Transparancy
+static void pal_trans_rows(void *data, int start, int end)
+{
+   (void)data;
+
+   for(int i = start;i<end;i++)
    {
       for(int j = 0;j<256;j++)
       {
@@ -31,6 +31,7 @@ static int16_t port_cam_shear = 0;
 static int16_t port_cam_sector = 0;
 
 static RvR_fix22 port_fov = 256;
+static int port_threads = 1;
 //-------------------------------------
 
 //Function prototypes
@@ -88,6 +89,16 @@ RvR_fix22 RvR_port_get_fov()
    return port_fov;
 }
 
+void RvR_port_set_threads(int threads)
+{
+   port_threads = RvR_clamp(threads,1,RVR_PORT_MAX_THREADS);
+}
+
+int RvR_port_get_threads()
+{
+   return port_threads;
+}
+
 RvR_fix22 RvR_port_perspective_scale_vertical_inverse(RvR_fix22 org_size, RvR_fix22 sc_size)
 {
    static RvR_fix22 correction_factor;
@@ -22,6 +22,9 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //#defines
 #define TEX_AND ((1<<RVR_RAY_TEXTURE)-1)
 #define TEX_MUL (1<<RVR_RAY_TEXTURE)
+
+//Planes per band, grows when exceeded
+#define PORT_PLANES_INIT 256
 //-------------------------------------
 
 //Typedefs
@@ -46,6 +49,10 @@ typedef struct
    RvR_fix22 st0;
    RvR_fix22 st1;
 
+   //Fetched while building the potvis,
+   //bands must not call RvR_texture_get()
+   RvR_texture *texture;
+
    //Corresponding sector/wall
    int16_t wall;
    int16_t sector;
@@ -69,22 +76,79 @@ typedef struct
    uint16_t end[RVR_XRES+2];
 }port_plane;
 
+RvR_stack_type(port_plane,port_stack_plane);
+
+typedef struct
+{
+   RvR_texture *texture;
+   uint32_t flags;
+   RvR_fix22 depth;
+   uint8_t shade;
+
+   //Index into port_sprite_clips
+   int16_t clip;
+
+   //Screen rectangle, x1/y1 exclusive
+   int x0;
+   int x1;
+   int y0;
+   int y1;
+
+   //Texture coordinates at x0/y0, 16.16 fixed point
+   RvR_fix22 u;
+   RvR_fix22 v;
+   RvR_fix22 step_u;
+   RvR_fix22 step_v;
+}port_sprite;
+
+//Rows [top,bottom] of every column a sector was visible through,
+//recorded while the walls of the sector are drawn
+typedef struct
+{
+   int16_t top[RVR_XRES];
+   int16_t bottom[RVR_XRES];
+}port_sprite_clip;
+
+typedef struct
+{
+   //Columns [x0,x1] are drawn by this band
+   int x0;
+   int x1;
+
+   //Occlusion arrays
+   int_fast16_t ymin[RVR_XRES];
+   int_fast16_t ymax[RVR_XRES];
+
+   //Depth of solid wall in column, sprites behind it
+   //can still be inside the window of a concave sector
+   RvR_fix22 depth[RVR_XRES];
+
+   port_stack_plane planes;
+   RvR_fix22 span_start[RVR_YRES];
+}port_band;
+
 RvR_stack_type(int16_t,port_stack_i16);
 RvR_stack_type(port_potwall_element,port_stack_potwall);
 RvR_stack_type(port_potvis_element,port_stack_potvis);
+RvR_stack_type(port_sprite,port_stack_sprite);
+RvR_stack_type(port_sprite_clip,port_stack_sprite_clip);
 //-------------------------------------
 
 //Variables
 static port_stack_potwall port_potwall = {0};
 static port_stack_potvis port_potvis = {0};
+static port_stack_i16 port_draw_order = {0};
+static port_stack_sprite port_sprites = {0};
+static port_stack_sprite_clip port_sprite_clips = {0};
 static int32_t port_middle_row = 0;
 
-static int_fast16_t port_ymin[RVR_XRES];
-static int_fast16_t port_ymax[RVR_XRES];
+static port_band port_bands[RVR_PORT_MAX_THREADS];
+
+//Ceiling (0) and floor (1) texture of every sector visited this frame
+static RvR_texture *port_sector_tex[RVR_PORT_MAX_SECTORS][2];
 
-static int port_planes_used;
-static port_plane port_planes[256];
-static RvR_fix22 port_span_start[RVR_YRES];
+//Sprite clip of every sector visited this frame, -1 if it has no sprites
+static int16_t port_sector_clip[RVR_PORT_MAX_SECTORS];
 
 static RvR_vec2 port_cam_dir0;
 static RvR_vec2 port_cam_dir1;
@@ -93,19 +157,29 @@ static RvR_fix22 port_fov_factor_y;
 //-------------------------------------
 
 //Function prototypes
-RvR_stack_function_prototype(int16_t,port_stack_i16,static);
-RvR_stack_function_prototype(port_potwall_element,port_stack_potwall,static);
-RvR_stack_function_prototype(port_potvis_element,port_stack_potvis,static);
+RvR_stack_function_prototype(int16_t,port_stack_i16,static inline);
+RvR_stack_function_prototype(port_potwall_element,port_stack_potwall,static inline);
+RvR_stack_function_prototype(port_potvis_element,port_stack_potvis,static inline);
+RvR_stack_function_prototype(port_sprite,port_stack_sprite,static inline);
+RvR_stack_function_prototype(port_sprite_clip,port_stack_sprite_clip,static inline);
+RvR_stack_function_prototype(port_plane,port_stack_plane,static inline);
 
 static void port_potvis_build();
+static void port_sprites_project(int16_t sector, RvR_fix22 cos, RvR_fix22 sin, RvR_fix22 cos_fov, RvR_fix22 sin_fov);
+static int  port_sprite_cmp(const void *a, const void *b);
 
-static void port_wall_draw(int wall_num);
+static void port_bands_draw();
+static void port_bands_job(void *data, int start, int end);
+static void port_band_draw(port_band *band);
+
+static void port_wall_draw(port_band *band, int wall_num);
 
 static int port_potvis_order(int16_t va, int16_t vb);
 static int port_wall_order(int16_t a, int16_t b);
 
-static void port_plane_add(int16_t sector, int16_t pos, int x, int y0, int y1);
-static void port_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, const RvR_texture *texture);
+static void port_plane_add(port_band *band, int16_t sector, int16_t pos, int x, int y0, int y1);
+static void port_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, uint8_t shade, const RvR_texture *texture);
+static void port_sprites_draw(port_band *band);
 //-------------------------------------
 
 //Function implementations
@@ -116,15 +190,7 @@ void RvR_port_draw_2d()
 
 void RvR_port_draw()
 {
-   //Clear planes
-   port_planes_used = 0;
-
-   //Clear occlusion arrays
-   memset(port_ymin,0,sizeof(port_ymin));
-   for(int i = 0;i<RVR_XRES;i++) port_ymax[i] = RVR_YRES-1;
-
    //Initialize necessary variables
-   RvR_port_map *map = RvR_port_map_get();
    port_fov_factor_x = RvR_fix22_tan(RvR_port_get_fov()/2);
    port_fov_factor_y = (RVR_YRES*port_fov_factor_x*2)/RVR_XRES;
    port_middle_row = (RVR_YRES/2)+RvR_port_get_shear();
@@ -138,10 +204,12 @@ void RvR_port_draw()
 
    port_potvis_build();
 
-   //Sort and draw potvis walls
+   //Sort potvis walls front to back
+   port_stack_i16_clear(&port_draw_order);
+   RvR_frame_marker mark = RvR_frame_mark();
+   uint8_t *certain = RvR_frame_alloc(sizeof(*certain)*port_potvis.data_used);
    while(!port_stack_potvis_empty(&port_potvis))
    {
-      uint8_t certain[port_potvis.data_used];
       memset(certain,0,sizeof(*certain)*port_potvis.data_used);
       int16_t near = 0;
       certain[near] = 1;
@@ -169,18 +237,75 @@ void RvR_port_draw()
          }
       }while(!done);
 
-      for(int i = port_potvis.data[near].start;i>=0;i = port_potwall.data[i].next)
-         port_wall_draw(i);
+      port_stack_i16_push(&port_draw_order,port_potvis.data[near].start);
 
       port_potvis.data_used--;
       port_potvis.data[near] = port_potvis.data[port_potvis.data_used];
    }
+   RvR_frame_release(mark);
+   //-------------------------------------
+
+   //Sort sprites back to front
+   if(port_sprites.data_used>1)
+      qsort(port_sprites.data,port_sprites.data_used,sizeof(*port_sprites.data),port_sprite_cmp);
+
+   //Draw walls, planes and sprites
+   port_bands_draw();
+}
+
+//Occlusion only depends on the walls drawn in the same column,
+//so each band of columns can be drawn independently, with its own
+//occlusion arrays and planes
+static void port_bands_draw()
+{
+   int threads = RvR_port_get_threads();
+
+   for(int i = 0;i<threads;i++)
+   {
+      port_band *band = &port_bands[i];
+      band->x0 = (i*RVR_XRES)/threads;
+      band->x1 = ((i+1)*RVR_XRES)/threads-1;
+
+      //Allocated once and kept, not per frame
+      port_stack_plane_reserve(&band->planes,PORT_PLANES_INIT);
+   }
+
+   RvR_job_parallel_for(port_bands_job,NULL,threads,1);
+}
+
+static void port_bands_job(void *data, int start, int end)
+{
+   (void)data;
+
+   for(int i = start;i<end;i++)
+      port_band_draw(&port_bands[i]);
+}
+
+static void port_band_draw(port_band *band)
+{
+   RvR_port_map *map = RvR_port_map_get();
+
+   //Clear planes
+   port_stack_plane_clear(&band->planes);
+
+   //Clear occlusion arrays
+   for(int x = band->x0;x<=band->x1;x++)
+   {
+      band->ymin[x] = 0;
+      band->ymax[x] = RVR_YRES-1;
+      band->depth[x] = INT32_MAX;
+   }
+
+   //Draw potvis walls
+   for(unsigned i = 0;i<port_draw_order.data_used;i++)
+      for(int j = port_draw_order.data[i];j>=0;j = port_potwall.data[j].next)
+         port_wall_draw(band,j);
    //-------------------------------------
 
    //Render floor planes
-   for(int i = 0;i<port_planes_used;i++)
+   for(unsigned i = 0;i<band->planes.data_used;i++)
    {
-      port_plane *pl = &port_planes[i];
+      port_plane *pl = &band->planes.data[i];
 
       if(pl->min>pl->max)
          continue;
@@ -237,7 +362,7 @@ void RvR_port_draw()
       }*/
 
       //Convert plane to horizontal spans
-      RvR_texture *texture = RvR_texture_get(pl->pos?map->sectors[pl->sector].floor_tex:map->sectors[pl->sector].ceiling_tex);
+      RvR_texture *texture = port_sector_tex[pl->sector][pl->pos];
       for(int x = pl->min;x<pl->max+2;x++)
       {
          RvR_fix22 s0 = pl->start[x-1];
@@ -248,41 +373,64 @@ void RvR_port_draw()
          //End spans top
          for(;s0<s1&&s0<=e0;s0++)
          {
-            port_span_draw_tex(port_span_start[s0],x-1,s0,pl->pos?map->sectors[pl->sector].floor_height:map->sectors[pl->sector].ceiling_height,texture);
+            port_span_draw_tex(band->span_start[s0],x-1,s0,pl->pos?map->sectors[pl->sector].floor_height:map->sectors[pl->sector].ceiling_height,map->sectors[pl->sector].shade,texture);
          }
 
          //End spans bottom
          for(;e0>e1&&e0>=s0;e0--)
          {
-            port_span_draw_tex(port_span_start[e0],x-1,e0,pl->pos?map->sectors[pl->sector].floor_height:map->sectors[pl->sector].ceiling_height,texture);
+            port_span_draw_tex(band->span_start[e0],x-1,e0,pl->pos?map->sectors[pl->sector].floor_height:map->sectors[pl->sector].ceiling_height,map->sectors[pl->sector].shade,texture);
          }
 
          //Start spans top
          for(;s1<s0&&s1<=e1;s1++)
-            port_span_start[s1] = x-1;
+            band->span_start[s1] = x-1;
 
          //Start spans bottom
          for(;e1>e0&&e1>=s1;e1--)
-            port_span_start[e1] = x-1;
+            band->span_start[e1] = x-1;
       }
    }
    //-------------------------------------
+
+   port_sprites_draw(band);
 }
 
-static void port_wall_draw(int wall_num)
+static void port_wall_draw(port_band *band, int wall_num)
 {
    RvR_port_map *map = RvR_port_map_get();
    port_potwall_element *wall = &port_potwall.data[wall_num];
    RvR_fix22 width = (wall->sp1.x-wall->sp0.x)+1;
    int16_t portal = map->walls[wall->wall].portal;
 
+   //Clip to band
+   int x_start = RvR_max(wall->sp0.x,band->x0);
+   int x_end = RvR_min(wall->sp1.x,band->x1);
+   if(x_start>x_end)
+      return;
+   int skip = x_start-wall->sp0.x;
+
+   //Sprites in this sector are clipped to what is left
+   //of the columns before the wall gets drawn
+   int16_t clip = port_sector_clip[wall->sector];
+   if(clip>=0)
+   {
+      port_sprite_clip *sc = &port_sprite_clips.data[clip];
+      for(int x = x_start;x<=x_end;x++)
+      {
+         sc->top[x] = RvR_min(sc->top[x],band->ymin[x]);
+         sc->bottom[x] = RvR_max(sc->bottom[x],band->ymax[x]);
+      }
+   }
+
    //Normal wall
    if(portal<0)
    {
       int x0 = wall->sp0.x;
       int x1 = wall->sp1.x;
 
-      RvR_texture *texture = RvR_texture_get(map->walls[wall->wall].tex);
+      RvR_texture *texture = wall->texture;
+      uint8_t shade = map->sectors[wall->sector].shade;
       int mask = (1<<RvR_log2(texture->height))-1;
       RvR_fix22 scale_vertical = texture->height*16;
       int size0 = RVR_YRES*((scale_vertical*1024)/RvR_non_zero((port_fov_factor_y*wall->sp0.z)/1024));
@@ -293,12 +441,12 @@ static void port_wall_draw(int wall_num)
       RvR_fix22 depth0 = INT32_MAX/RvR_non_zero(wall->sp0.z);
       RvR_fix22 depth1 = INT32_MAX/RvR_non_zero(wall->sp1.z);
       RvR_fix22 step_depth = (depth1-depth0)/RvR_non_zero(x1-x0);
-      RvR_fix22 depth_i = depth0;
+      RvR_fix22 depth_i = depth0+step_depth*skip;
 
       RvR_fix22 st0 = (wall->st0*16*1024)/RvR_non_zero(wall->sp0.z);
       RvR_fix22 st1 = (wall->st1*16*1024)/RvR_non_zero(wall->sp1.z);
       RvR_fix22 step_u = (st1-st0)/RvR_non_zero(x1-x0);
-      RvR_fix22 u_i = st0;
+      RvR_fix22 u_i = st0+step_u*skip;
 
       RvR_fix22 t0 = y0-size0+512;
       RvR_fix22 t1 = y1-size1+512;
@@ -316,7 +464,7 @@ static void port_wall_draw(int wall_num)
       cy0 = port_middle_row*1024-cy0;
       cy1 = port_middle_row*1024-cy1;
       RvR_fix22 step_cy = (cy1-cy0)/width;
-      RvR_fix22 cy = cy0;
+      RvR_fix22 cy = cy0+step_cy*skip;
 
       //Floor
       RvR_fix22 fy0 = (RVR_YRES*(map->sectors[wall->sector].floor_height-RvR_port_get_position().z)*1024)/wall->sp0.z;
@@ -324,7 +472,7 @@ static void port_wall_draw(int wall_num)
       fy0 = port_middle_row*1024-fy0;
       fy1 = port_middle_row*1024-fy1;
       RvR_fix22 step_fy = (fy1-fy0)/width;
-      RvR_fix22 fy = fy0;
+      RvR_fix22 fy = fy0+step_fy*skip;
 
       const uint8_t * restrict col = NULL;
       uint8_t * restrict dst = NULL;
@@ -332,7 +480,7 @@ static void port_wall_draw(int wall_num)
 
       RvR_fix22 u_clamp = wall->st0*16;
       int clamp_dir = wall->st0<wall->st1;
-      for(int x = wall->sp0.x;x<=wall->sp1.x;x++)
+      for(int x = x_start;x<=x_end;x++)
       {
          RvR_fix22 depth = INT32_MAX/RvR_non_zero(depth_i);
          RvR_fix22 u = (u_i/1024)*depth;
@@ -349,27 +497,24 @@ static void port_wall_draw(int wall_num)
 
          RvR_fix22 step_v = (4*port_fov_factor_y*depth)/RVR_YRES;
 
-         int wy = port_ymin[x];
-         uint8_t * restrict pix = &RvR_core_framebuffer()[port_ymin[x]*RVR_XRES+x];
+         int wy = band->ymin[x];
+         uint8_t * restrict pix = &RvR_core_framebuffer()[band->ymin[x]*RVR_XRES+x];
 
          //Ceiling
-         int y_to = RvR_min(cy/1024,port_ymax[x]);
+         int y_to = RvR_min(cy/1024,band->ymax[x]);
          if(y_to>wy)
          {
-            port_plane_add(wall->sector,0,x,wy,y_to);
+            port_plane_add(band,wall->sector,0,x,wy,y_to);
             wy = y_to;
             pix = &RvR_core_framebuffer()[wy*RVR_XRES+x];
          }
 
-         if(RvR_core_key_down(RVR_KEY_SPACE))
-            RvR_core_render_present();
-
          RvR_fix22 v = (map->sectors[wall->sector].floor_height-RvR_ray_get_position().z)*4096+(wy-port_middle_row+1)*step_v;
 
          //Wall
-         y_to = RvR_min(fy/1024-1,port_ymax[x]);
+         y_to = RvR_min(fy/1024-1,band->ymax[x]);
          tex = &texture->data[texture->height*(u>>20)];
-         col = RvR_shade_table(RvR_min(63,depth>>9));
+         col = RvR_shade_table(RvR_min(63,(depth>>9)+shade));
          for(;wy<y_to;wy++)
          {
             uint8_t index = tex[(v>>16)&mask];
@@ -378,19 +523,14 @@ static void port_wall_draw(int wall_num)
             v+=step_v;
          }
 
-         if(RvR_core_key_down(RVR_KEY_SPACE))
-            RvR_core_render_present();
-
          //Floor
-         y_to = RvR_min(RVR_YRES-1,port_ymax[x]);
+         y_to = RvR_min(RVR_YRES-1,band->ymax[x]);
          if(y_to>wy)
-            port_plane_add(wall->sector,1,x,wy,y_to);
+            port_plane_add(band,wall->sector,1,x,wy,y_to);
 
-         if(RvR_core_key_down(RVR_KEY_SPACE))
-            RvR_core_render_present();
-
-         port_ymin[x] = RVR_YRES;
-         port_ymax[x] = 0;
+         band->ymin[x] = RVR_YRES;
+         band->ymax[x] = 0;
+         band->depth[x] = RvR_min(band->depth[x],depth);
 
          cy+=step_cy;
          fy+=step_fy;
@@ -666,35 +806,35 @@ static int port_wall_order(int16_t a, int16_t b)
    return -1;
 }
 
-static void port_plane_add(int16_t sector, int16_t pos, int x, int y0, int y1)
+static void port_plane_add(port_band *band, int16_t sector, int16_t pos, int x, int y0, int y1)
 {
    port_plane *cur = NULL;
    x+=1;
 
    //TODO: hash + linked list?
-   int i;
-   for(i = 0;i<port_planes_used;i++)
+   unsigned i;
+   for(i = 0;i<band->planes.data_used;i++)
    {
       //ray_planes need to have be in the same sector...
-      if(sector!=port_planes[i].sector)
+      if(sector!=band->planes.data[i].sector)
          continue;
       //... and the same pos (floor/ceiling) to be valid for concatination
-      if(pos!=port_planes[i].pos)
+      if(pos!=band->planes.data[i].pos)
          continue;
 
       //Additionally the spans collumn needs to be either empty...
-      if(port_planes[i].start[x]!=UINT16_MAX)
+      if(band->planes.data[i].start[x]!=UINT16_MAX)
       {
          //... or directly adjacent to each other vertically, in that case
          //Concat planes vertically
-         if(port_planes[i].start[x]-1==y1)
+         if(band->planes.data[i].start[x]-1==y1)
          {
-            port_planes[i].start[x] = y0;
+            band->planes.data[i].start[x] = y0;
             return;
          }
-         if(port_planes[i].end[x]+1==y0)
+         if(band->planes.data[i].end[x]+1==y0)
          {
-            port_planes[i].end[x] = y1;
+            band->planes.data[i].end[x] = y1;
             return;
          }
 
@@ -704,14 +844,13 @@ static void port_plane_add(int16_t sector, int16_t pos, int x, int y0, int y1)
       break;
    }
 
-   if(i==port_planes_used)
+   if(i==band->planes.data_used)
    {
-      if(port_planes_used==256)
-      {
-         //TODO
-      }
+      //Grown in place instead of pushing, planes are large
+      if(band->planes.data_used==band->planes.data_size)
+         port_stack_plane_reserve(&band->planes,band->planes.data_size*2);
 
-      cur = &port_planes[port_planes_used++];
+      cur = &band->planes.data[band->planes.data_used++];
       cur->min = RVR_XRES;
       cur->max = -1;
       cur->sector = sector;
@@ -722,7 +861,7 @@ static void port_plane_add(int16_t sector, int16_t pos, int x, int y0, int y1)
    }
    else
    {
-      cur = &port_planes[i];
+      cur = &band->planes.data[i];
    }
 
    if(x<cur->min)
@@ -734,7 +873,7 @@ static void port_plane_add(int16_t sector, int16_t pos, int x, int y0, int y1)
    cur->start[x] = y0;
 }
 
-static void port_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, const RvR_texture *texture)
+static void port_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, uint8_t shade, const RvR_texture *texture)
 {
    //Shouldn't happen
    if(x0>=x1)
@@ -757,7 +896,7 @@ static void port_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, const Rv
 
    //const and restrict don't seem to influence the generated assembly in this case
    uint8_t * restrict pix = &RvR_core_framebuffer()[y*RVR_XRES+x0];
-   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(depth>>8)));
+   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(depth>>8)+shade));
    const uint8_t * restrict tex = texture->data;
 
 #if RVR_UNROLL
@@ -802,36 +941,58 @@ static void port_potvis_build()
    RvR_fix22 cos_fov = (cos*port_fov_factor_x)/1024;
    RvR_fix22 sin_fov = (sin*port_fov_factor_x)/1024;
 
+   if(map->geometry_dirty)
+      RvR_port_map_geometry_update();
+
    port_stack_i16_clear(&to_visit);
    port_stack_potwall_clear(&port_potwall);
    port_stack_potvis_clear(&port_potvis);
+   port_stack_sprite_clear(&port_sprites);
+   port_stack_sprite_clip_clear(&port_sprite_clips);
 
    port_stack_i16_push(&to_visit,RvR_port_get_sector());
    while(!port_stack_i16_empty(&to_visit))
    {
       int16_t sector = port_stack_i16_pop(&to_visit);
+
+      //A sector can be queued multiple times before being visited
+      if(!(visited[sector/32]&(1<<(sector&31))))
+         port_sprites_project(sector,cos,sin,cos_fov,sin_fov);
       visited[sector/32]|=1<<(sector&31);
 
+      //Textures are fetched here, the pointers stay valid during
+      //drawing as long as a frame doesn't use more than RVR_TEXTURE_MAX textures
+      port_sector_tex[sector][0] = RvR_texture_get(map->sectors[sector].ceiling_tex);
+      port_sector_tex[sector][1] = RvR_texture_get(map->sectors[sector].floor_tex);
+
       int potwall_start_used = port_potwall.data_used;
       int potwall_first = port_potwall.data_used;
 
       RvR_port_wall *wall0 = &map->walls[map->sectors[sector].first_wall];
-      RvR_port_wall *wall1 = NULL;
+      RvR_port_wall_geometry *geo = &map->wall_geometry[map->sectors[sector].first_wall];
       RvR_vec2 to_point0 = {0};
       RvR_vec2 to_point1 = {0};
-      for(int i = 0;i<map->sectors[sector].num_walls;i++,wall0++)
+      int to_point1_valid = 0;
+      for(int i = 0;i<map->sectors[sector].num_walls;i++,wall0++,geo++)
       {
-         wall1 = &map->walls[wall0->p2];
          int32_t x0 = wall0->x-RvR_port_get_position().x;
          int32_t y0 = wall0->y-RvR_port_get_position().y;
-         int32_t x1 = wall1->x-RvR_port_get_position().x;
-         int32_t y1 = wall1->y-RvR_port_get_position().y;
+         int32_t x1 = x0+geo->dir.x;
+         int32_t y1 = y0+geo->dir.y;
          port_potwall_element potwall = {0};
 
+         //Wall not facing camera, checked with the cached
+         //normal before transforming anything
+         if((geo->normal.x*x0+geo->normal.y*y0)/1024>0)
+         {
+            to_point1_valid = 0;
+            goto skip;
+         }
+
          //Rotate to camera space
          //y is depth
          //x is x coordinate
-         if(i==0||(wall0-1)->p2!=i+map->sectors[sector].first_wall)
+         if(i==0||!to_point1_valid||(wall0-1)->p2!=i+map->sectors[sector].first_wall)
          {
             to_point0.x = (-x0*sin+y0*cos)/1024; 
             to_point0.y = (x0*cos_fov+y0*sin_fov)/1024; 
@@ -842,6 +1003,7 @@ static void port_potvis_build()
          }
          to_point1.x = (-x1*sin+y1*cos)/1024; 
          to_point1.y = (x1*cos_fov+y1*sin_fov)/1024; 
+         to_point1_valid = 1;
          
          //Wall fully behind camera 
          if(to_point0.y<-128&&to_point1.y<-128)
@@ -943,6 +1105,8 @@ static void port_potvis_build()
          //potwall.w1_depth = to_point1.y;
          potwall.wall = i+map->sectors[sector].first_wall;
          potwall.sector = sector;
+         if(wall0->portal<0)
+            potwall.texture = RvR_texture_get(wall0->tex);
          potwall.next = port_potwall.data_used+1;
          port_stack_potwall_push(&port_potwall,potwall);
 
@@ -987,9 +1151,177 @@ skip:
    }
 }
 
-RvR_stack_function(int16_t,port_stack_i16,16,16,static);
-RvR_stack_function(port_potwall_element,port_stack_potwall,16,16,static);
-RvR_stack_function(port_potvis_element,port_stack_potvis,16,16,static);
+static void port_sprites_project(int16_t sector, RvR_fix22 cos, RvR_fix22 sin, RvR_fix22 cos_fov, RvR_fix22 sin_fov)
+{
+   RvR_port_map *map = RvR_port_map_get();
+   RvR_vec3 cam = RvR_port_get_position();
+
+   port_sector_clip[sector] = -1;
+
+   for(int32_t i = map->sectors[sector].sprite_first;i>=0;i = RvR_port_sprite_get(i)->next)
+   {
+      RvR_port_sprite *sp = RvR_port_sprite_get(i);
+
+      //Sprite tagged as invisible --> don't draw
+      if(sp->flags&1)
+         continue;
+
+      //Rotate to camera space
+      RvR_fix22 x = sp->pos.x-cam.x;
+      RvR_fix22 y = sp->pos.y-cam.y;
+      RvR_fix22 tpx = (-x*sin+y*cos)/1024;
+      RvR_fix22 depth = (x*cos_fov+y*sin_fov)/1024;
+
+      //Near clip
+      if(depth<16)
+         continue;
+
+      RvR_texture *texture = RvR_texture_get(sp->tex);
+      RvR_fix22 half_width = texture->width*8;
+
+      //Completely out of sight
+      if(tpx-half_width>depth||tpx+half_width<-depth)
+         continue;
+
+      port_sprite p = {0};
+      p.texture = texture;
+      p.flags = sp->flags;
+      p.depth = depth;
+      p.shade = map->sectors[sector].shade;
+
+      //Dimensions
+      RvR_fix22 left = ((tpx-half_width)*1024)/depth;
+      left = RVR_XRES*512+left*(RVR_XRES/2);
+      RvR_fix22 right = ((tpx+half_width)*1024)/depth;
+      right = RVR_XRES*512+right*(RVR_XRES/2);
+      RvR_fix22 top = ((sp->pos.z+texture->height*16-cam.z)*1024)/depth;
+      top = port_middle_row*1024-top*RVR_YRES;
+      RvR_fix22 bot = ((sp->pos.z-cam.z)*1024)/depth;
+      bot = port_middle_row*1024-bot*RVR_YRES;
+
+      //Pixels [x0,x1) x [y0,y1) are covered
+      p.x0 = (left+1023)/1024;
+      p.x1 = (right+1023)/1024;
+      p.y0 = (top+1023)/1024;
+      p.y1 = (bot+1023)/1024;
+      p.step_u = (depth*8192)/RVR_XRES;
+      p.step_v = (depth*4096)/RVR_YRES;
+      p.u = (p.step_u*(p.x0*1024-left))/1024;
+      p.v = (p.step_v*(p.y0*1024-top))/1024;
+
+      //Screen clip, occlusion is handled per column
+      //by the sector's clip while drawing
+      if(p.x0<0)
+      {
+         p.u+=(-p.x0)*p.step_u;
+         p.x0 = 0;
+      }
+      p.x1 = RvR_min(p.x1,RVR_XRES);
+      if(p.y0<0)
+      {
+         p.v+=(-p.y0)*p.step_v;
+         p.y0 = 0;
+      }
+      p.y1 = RvR_min(p.y1,RVR_YRES);
+
+      if(p.x0>=p.x1||p.y0>=p.y1)
+         continue;
+
+      //First sprite in sector, start with nothing visible
+      if(port_sector_clip[sector]<0)
+      {
+         port_sprite_clip sc;
+         for(int c = 0;c<RVR_XRES;c++)
+         {
+            sc.top[c] = RVR_YRES;
+            sc.bottom[c] = -1;
+         }
+         port_sector_clip[sector] = port_sprite_clips.data_used;
+         port_stack_sprite_clip_push(&port_sprite_clips,sc);
+      }
+      p.clip = port_sector_clip[sector];
+
+      port_stack_sprite_push(&port_sprites,p);
+   }
+}
+
+static int port_sprite_cmp(const void *a, const void *b)
+{
+   const port_sprite *sa = a;
+   const port_sprite *sb = b;
+
+   return (sa->depth<sb->depth)-(sa->depth>sb->depth);
+}
+
+//Sprites are drawn back to front after walls and planes,
+//every column is clipped to the rows its sector was visible through
+//and to the nearest solid wall
+static void port_sprites_draw(port_band *band)
+{
+   for(unsigned i = 0;i<port_sprites.data_used;i++)
+   {
+      port_sprite *sp = &port_sprites.data[i];
+      port_sprite_clip *sc = &port_sprite_clips.data[sp->clip];
+      RvR_texture *texture = sp->texture;
+
+      int x0 = RvR_max(sp->x0,band->x0);
+      int x1 = RvR_min(sp->x1,band->x1+1);
+      RvR_fix22 u = sp->u+(x0-sp->x0)*sp->step_u;
+
+      const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(sp->depth>>9)+sp->shade));
+      uint8_t * restrict dst = NULL;
+      const uint8_t * restrict tex = NULL;
+      for(int x = x0;x<x1;x++,u+=sp->step_u)
+      {
+         if(sp->depth>=band->depth[x])
+            continue;
+
+         int y0 = RvR_max(sp->y0,sc->top[x]);
+         int y1 = RvR_min(sp->y1,sc->bottom[x]+1);
+         if(y0>=y1)
+            continue;
+
+         tex = &texture->data[texture->height*RvR_min(texture->width-1,u>>16)];
+         dst = &RvR_core_framebuffer()[y0*RVR_XRES+x];
+         RvR_fix22 v = sp->v+(y0-sp->y0)*sp->step_v;
+
+         if(sp->flags&32)
+         {
+            for(int y = y0;y<y1;y++,dst+=RVR_XRES)
+            {
+               uint8_t index = tex[RvR_min(texture->height-1,v>>16)];
+               *dst = RvR_blend(col[index],*dst);
+               v+=sp->step_v;
+            }
+         }
+         else if(sp->flags&64)
+         {
+            for(int y = y0;y<y1;y++,dst+=RVR_XRES)
+            {
+               uint8_t index = tex[RvR_min(texture->height-1,v>>16)];
+               *dst = RvR_blend(*dst,col[index]);
+               v+=sp->step_v;
+            }
+         }
+         else
+         {
+            for(int y = y0;y<y1;y++,dst+=RVR_XRES)
+            {
+               uint8_t index = tex[RvR_min(texture->height-1,v>>16)];
+               *dst = index?col[index]:*dst;
+               v+=sp->step_v;
+            }
+         }
+      }
+   }
+}
+
+RvR_stack_function(int16_t,port_stack_i16,16,16,static inline)
+RvR_stack_function(port_potwall_element,port_stack_potwall,16,16,static inline)
+RvR_stack_function(port_potvis_element,port_stack_potvis,16,16,static inline)
+RvR_stack_function(port_sprite,port_stack_sprite,16,16,static inline)
+RvR_stack_function(port_sprite_clip,port_stack_sprite_clip,4,4,static inline)
+RvR_stack_function(port_plane,port_stack_plane,PORT_PLANES_INIT,PORT_PLANES_INIT,static inline)
 
 #undef TEX_AND
 #undef TEX_MUL
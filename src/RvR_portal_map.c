@@ -22,13 +22,19 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //Typedefs
+RvR_pool_type(RvR_port_sprite,port_pool_sprite);
 //-------------------------------------
 
 //Variables
 RvR_port_map port_map = {0};
+
+static port_pool_sprite port_sprite_pool = {0};
 //-------------------------------------
 
 //Function prototypes
+RvR_pool_function_prototype(RvR_port_sprite,port_pool_sprite,static inline);
+
+static void port_sprite_unlink(int32_t sprite);
 //-------------------------------------
 
 //Function implementations
@@ -36,10 +42,128 @@ RvR_port_map port_map = {0};
 void RvR_port_map_create()
 {
    memset(&port_map,0,sizeof(port_map));
+   for(int i = 0;i<RVR_PORT_MAX_SECTORS;i++)
+      port_map.sectors[i].sprite_first = -1;
+
+   //Walls get added after creation
+   port_map.geometry_dirty = 1;
+
+   //Sprites belong to the old map's sectors --> free all of them
+   port_pool_sprite_reset(&port_sprite_pool);
+}
+
+int32_t RvR_port_sprite_new(int16_t sector)
+{
+   int32_t sprite = port_pool_sprite_alloc(&port_sprite_pool);
+   RvR_port_sprite *sp = port_pool_sprite_get(&port_sprite_pool,sprite);
+   memset(sp,0,sizeof(*sp));
+   sp->sector = -1;
+   sp->prev = -1;
+   sp->next = -1;
+
+   RvR_port_sprite_move(sprite,sector);
+
+   return sprite;
+}
+
+void RvR_port_sprite_free(int32_t sprite)
+{
+   if(sprite<0||sprite>=port_sprite_pool.capacity)
+      return;
+
+   port_sprite_unlink(sprite);
+   port_pool_sprite_free(&port_sprite_pool,sprite);
+}
+
+RvR_port_sprite *RvR_port_sprite_get(int32_t sprite)
+{
+   if(sprite<0||sprite>=port_sprite_pool.capacity)
+      return NULL;
+
+   return port_pool_sprite_get(&port_sprite_pool,sprite);
+}
+
+void RvR_port_sprite_move(int32_t sprite, int16_t sector)
+{
+   if(sprite<0||sprite>=port_sprite_pool.capacity)
+      return;
+
+   RvR_port_sprite *sp = port_pool_sprite_get(&port_sprite_pool,sprite);
+   if(sp->sector==sector)
+      return;
+
+   port_sprite_unlink(sprite);
+
+   //Insert at head of new sector's list
+   //Sprites outside of all sectors (sector -1) are never drawn
+   if(sector<0||sector>=RVR_PORT_MAX_SECTORS)
+      return;
+
+   sp->sector = sector;
+   sp->prev = -1;
+   sp->next = port_map.sectors[sector].sprite_first;
+   if(sp->next>=0)
+      port_pool_sprite_get(&port_sprite_pool,sp->next)->prev = sprite;
+   port_map.sectors[sector].sprite_first = sprite;
+}
+
+static void port_sprite_unlink(int32_t sprite)
+{
+   RvR_port_sprite *sp = port_pool_sprite_get(&port_sprite_pool,sprite);
+   if(sp->sector<0)
+      return;
+
+   if(sp->prev>=0)
+      port_pool_sprite_get(&port_sprite_pool,sp->prev)->next = sp->next;
+   else
+      port_map.sectors[sp->sector].sprite_first = sp->next;
+   if(sp->next>=0)
+      port_pool_sprite_get(&port_sprite_pool,sp->next)->prev = sp->prev;
+
+   sp->sector = -1;
+   sp->prev = -1;
+   sp->next = -1;
 }
 
 RvR_port_map *RvR_port_map_get()
 {
    return &port_map;
 }
+
+void RvR_port_map_geometry_update()
+{
+   for(int16_t i = 0;i<port_map.num_sectors;i++)
+      RvR_port_sector_geometry_update(i);
+   port_map.geometry_dirty = 0;
+}
+
+void RvR_port_sector_geometry_update(int16_t sector)
+{
+   if(sector<0||sector>=port_map.num_sectors)
+      return;
+
+   RvR_port_sector *sec = &port_map.sectors[sector];
+   sec->bb_min.x = INT32_MAX;
+   sec->bb_min.y = INT32_MAX;
+   sec->bb_max.x = INT32_MIN;
+   sec->bb_max.y = INT32_MIN;
+
+   for(int i = sec->first_wall;i<sec->first_wall+sec->num_walls;i++)
+   {
+      RvR_port_wall *wall = &port_map.walls[i];
+      RvR_port_wall_geometry *geo = &port_map.wall_geometry[i];
+
+      geo->dir.x = port_map.walls[wall->p2].x-wall->x;
+      geo->dir.y = port_map.walls[wall->p2].y-wall->y;
+      geo->length = RvR_len2(geo->dir);
+      geo->normal.x = (-geo->dir.y*1024)/RvR_non_zero(geo->length);
+      geo->normal.y = (geo->dir.x*1024)/RvR_non_zero(geo->length);
+
+      sec->bb_min.x = RvR_min(sec->bb_min.x,wall->x);
+      sec->bb_min.y = RvR_min(sec->bb_min.y,wall->y);
+      sec->bb_max.x = RvR_max(sec->bb_max.x,wall->x);
+      sec->bb_max.y = RvR_max(sec->bb_max.y,wall->y);
+   }
+}
+RvR_pool_function(RvR_port_sprite,port_pool_sprite,7,static inline)
 //-------------------------------------
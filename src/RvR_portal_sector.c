@@ -39,22 +39,31 @@ int RvR_port_sector_inside(int16_t sector, RvR_fix22 x, RvR_fix22 y)
    if(sector>=map->num_sectors||sector<0)
       return 0;
 
-   RvR_port_wall *wall = &map->walls[map->sectors[sector].first_wall];
+   if(map->geometry_dirty)
+      RvR_port_map_geometry_update();
+
+   //Early out: outside of bounding box
+   RvR_port_sector *sec = &map->sectors[sector];
+   if(x<sec->bb_min.x||x>sec->bb_max.x||y<sec->bb_min.y||y>sec->bb_max.y)
+      return 0;
+
+   RvR_port_wall *wall = &map->walls[sec->first_wall];
+   RvR_port_wall_geometry *geo = &map->wall_geometry[sec->first_wall];
    RvR_fix22 x0 = 0;
    RvR_fix22 y0 = 0;
    RvR_fix22 x1 = 0;
    RvR_fix22 y1 = 0;
    int crossed = 0;
 
-   for(int i = 0;i<map->sectors[sector].num_walls;i++,wall++)
+   for(int i = 0;i<sec->num_walls;i++,wall++,geo++)
    {
       //Subtract targeted point from coordinates
       //The targeted point is now at 0/0 and the coordinates
       //are relative to that
       x0 = wall->x-x;
       y0 = wall->y-y;
-      x1 = map->walls[wall->p2].x-x;
-      y1 = map->walls[wall->p2].y-y;
+      x1 = x0+geo->dir.x;
+      y1 = y0+geo->dir.y;
 
       //If both integers have the same sign (i.e. both are negative/positive)
       //the line is completely above/below the targeted point and does not need to
@@ -26,10 +26,32 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //Variables
+static RvR_vec3 p3d_cam_position = {0};
+static RvR_fix22 p3d_fov = 256;
 //-------------------------------------
 
 //Function prototypes
 //-------------------------------------
 
 //Function implementations
+
+void RvR_p3d_set_position(RvR_vec3 position)
+{
+   p3d_cam_position = position;
+}
+
+RvR_vec3 RvR_p3d_get_position()
+{
+   return p3d_cam_position;
+}
+
+void RvR_p3d_set_fov(RvR_fix22 fov)
+{
+   p3d_fov = fov;
+}
+
+RvR_fix22 RvR_p3d_get_fov()
+{
+   return p3d_fov;
+}
 //-------------------------------------
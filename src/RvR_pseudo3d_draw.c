@@ -20,62 +20,284 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //#defines
+#define P3D_NEAR 16
 //-------------------------------------
 
 //Typedefs
+typedef struct
+{
+   int x;
+   int y;
+   int w; //Half of road width
+}p3d_screen_point;
+
+typedef struct
+{
+   uint16_t tex;
+   uint16_t flags;
+
+   //Unclipped screen rectangle, x1/y1 exclusive
+   int x0;
+   int x1;
+   int y0;
+   int y1;
+
+   //Rows starting at clip are covered by nearer segments
+   int clip;
+
+   //16.16 fixed point
+   RvR_fix22 step_u;
+   RvR_fix22 step_v;
+}p3d_sprite_draw;
+
+RvR_stack_type(p3d_sprite_draw,p3d_stack_sprite);
+RvR_pool_type(RvR_p3d_sprite,p3d_pool_sprite);
 //-------------------------------------
 
 //Variables
 
-//Sprites
-static RvR_p3d_sprite *p3d_sprite_array = NULL;
-static int32_t p3d_sprite_array_size = 0;
-static int32_t p3d_sprite_pool = 0;
+static p3d_pool_sprite p3d_sprite_pool = {0};
+
+static RvR_fix22 p3d_fov_factor = 0;
+static int p3d_clip_y = RVR_YRES;
+static p3d_stack_sprite p3d_sprites = {0};
 //-------------------------------------
 
 //Function prototypes
+RvR_stack_function_prototype(p3d_sprite_draw,p3d_stack_sprite,static inline);
+RvR_pool_function_prototype(RvR_p3d_sprite,p3d_pool_sprite,static inline);
+
+static p3d_screen_point p3d_project(RvR_fix22 x, RvR_fix22 y, RvR_fix22 z);
+static void p3d_segment_draw(const RvR_p3d_segment *seg, p3d_screen_point s0, p3d_screen_point s1);
+static void p3d_span(uint8_t *row, int x0, int x1, uint8_t color);
+static void p3d_sprite_project(const RvR_p3d_sprite *sp, p3d_screen_point s, int clip);
 //-------------------------------------
 
 //Function implementations
 
 int32_t RvR_p3d_sprite_new()
 {
-   if(p3d_sprite_pool==-1)
-   {
-      p3d_sprite_array_size+=128;
-      p3d_sprite_array = RvR_realloc(p3d_sprite_array,sizeof(*p3d_sprite_array)*p3d_sprite_array_size);
-      for(int i = p3d_sprite_array_size-128;i<p3d_sprite_array_size-1;i++)
-         p3d_sprite_array[i].next = i+1;
-      p3d_sprite_array[p3d_sprite_array_size-1].next = -1;
-      p3d_sprite_pool = p3d_sprite_array_size-128;
-   }
-
-   int32_t sprite = p3d_sprite_pool;
-   p3d_sprite_pool = p3d_sprite_array[p3d_sprite_pool].next;
-   memset(&p3d_sprite_array[sprite],0,sizeof(*p3d_sprite_array));
-   p3d_sprite_array[sprite].next = -1;
+   int32_t sprite = p3d_pool_sprite_alloc(&p3d_sprite_pool);
+   RvR_p3d_sprite *sp = p3d_pool_sprite_get(&p3d_sprite_pool,sprite);
+   memset(sp,0,sizeof(*sp));
+   sp->next = -1;
 
    return sprite;
 }
 
 void RvR_p3d_sprite_free(int32_t sprite)
 {
-   if(sprite==-1||sprite>=p3d_sprite_array_size)
+   if(sprite<0||sprite>=p3d_sprite_pool.capacity)
       return;
 
-   p3d_sprite_array[sprite].next = p3d_sprite_pool;
-   p3d_sprite_pool = sprite;
+   p3d_pool_sprite_free(&p3d_sprite_pool,sprite);
+}
+
+RvR_p3d_sprite *RvR_p3d_sprite_get(int32_t sprite)
+{
+   if(sprite<0||sprite>=p3d_sprite_pool.capacity)
+      return NULL;
+
+   return p3d_pool_sprite_get(&p3d_sprite_pool,sprite);
 }
 
 void RvR_p3d_draw_begin()
 {
+   p3d_fov_factor = RvR_fix22_tan(RvR_p3d_get_fov()/2);
+   p3d_clip_y = RVR_YRES;
+   p3d_stack_sprite_clear(&p3d_sprites);
 }
 
+//Only segments within RVR_P3D_DRAW_DISTANCE get projected, the
+//track is drawn front to back, each segment only drawing the rows
+//not already covered by nearer segments
 void RvR_p3d_draw_track()
 {
+   if(RvR_p3d_track_length()==0)
+      return;
+
+   RvR_vec3 cam = RvR_p3d_get_position();
+   int32_t base = RvR_div_round_down(cam.z,RVR_P3D_SEGMENT_LENGTH);
+   RvR_fix22 offset = cam.z-base*RVR_P3D_SEGMENT_LENGTH;
+
+   //Curves are accumulated relative to the camera's position
+   //in its segment
+   RvR_fix22 x = 0;
+   RvR_fix22 dx = -(RvR_p3d_segment_get(base)->curve*offset)/RVR_P3D_SEGMENT_LENGTH;
+
+   for(int i = 0;i<RVR_P3D_DRAW_DISTANCE;i++)
+   {
+      RvR_p3d_segment *seg = RvR_p3d_segment_get(base+i);
+      RvR_fix22 z0 = i*RVR_P3D_SEGMENT_LENGTH-offset;
+      RvR_fix22 z1 = z0+RVR_P3D_SEGMENT_LENGTH;
+
+      p3d_screen_point s0 = p3d_project(x,seg->p0.y,z0);
+      p3d_screen_point s1 = p3d_project(x+dx,seg->p1.y,z1);
+      x+=dx;
+      dx+=seg->curve;
+
+      int clip = p3d_clip_y;
+
+      //Skip segments behind the camera, facing away
+      //(steep downhill) or hidden behind nearer hills
+      if(z1>P3D_NEAR&&s1.y<s0.y&&s1.y<p3d_clip_y)
+      {
+         p3d_segment_draw(seg,s0,s1);
+         p3d_clip_y = RvR_max(0,s1.y);
+      }
+
+      if(z0>=P3D_NEAR)
+      {
+         for(int32_t j = seg->sprite_first;j>=0;j = p3d_pool_sprite_get(&p3d_sprite_pool,j)->next)
+            p3d_sprite_project(p3d_pool_sprite_get(&p3d_sprite_pool,j),s0,clip);
+      }
+   }
 }
 
+//Sprites were collected front to back, drawing them
+//in reverse order gives back to front
 void RvR_p3d_draw_end()
 {
+   for(int i = (int)p3d_sprites.data_used-1;i>=0;i--)
+   {
+      p3d_sprite_draw *sp = &p3d_sprites.data[i];
+      RvR_texture *texture = RvR_texture_get(sp->tex);
+
+      int x0 = RvR_max(0,sp->x0);
+      int x1 = RvR_min(RVR_XRES,sp->x1);
+      int y0 = RvR_max(0,sp->y0);
+      int y1 = RvR_min(RvR_min(RVR_YRES,sp->y1),sp->clip);
+      if(x0>=x1||y0>=y1)
+         continue;
+
+      RvR_fix22 u = (x0-sp->x0)*sp->step_u;
+      RvR_fix22 v_start = (y0-sp->y0)*sp->step_v;
+
+      uint8_t * restrict dst = NULL;
+      const uint8_t * restrict tex = NULL;
+      for(int x = x0;x<x1;x++,u+=sp->step_u)
+      {
+         tex = &texture->data[texture->height*RvR_min(texture->width-1,u>>16)];
+         dst = &RvR_core_framebuffer()[y0*RVR_XRES+x];
+         RvR_fix22 v = v_start;
+
+         if(sp->flags&32)
+         {
+            for(int y = y0;y<y1;y++,dst+=RVR_XRES,v+=sp->step_v)
+            {
+               uint8_t index = tex[RvR_min(texture->height-1,v>>16)];
+               *dst = RvR_blend(index,*dst);
+            }
+         }
+         else if(sp->flags&64)
+         {
+            for(int y = y0;y<y1;y++,dst+=RVR_XRES,v+=sp->step_v)
+            {
+               uint8_t index = tex[RvR_min(texture->height-1,v>>16)];
+               *dst = RvR_blend(*dst,index);
+            }
+         }
+         else
+         {
+            for(int y = y0;y<y1;y++,dst+=RVR_XRES,v+=sp->step_v)
+            {
+               uint8_t index = tex[RvR_min(texture->height-1,v>>16)];
+               *dst = index?index:*dst;
+            }
+         }
+      }
+   }
+
+   p3d_stack_sprite_clear(&p3d_sprites);
+}
+
+static p3d_screen_point p3d_project(RvR_fix22 x, RvR_fix22 y, RvR_fix22 z)
+{
+   RvR_vec3 cam = RvR_p3d_get_position();
+   RvR_fix22 depth = RvR_non_zero((RvR_max(z,P3D_NEAR)*p3d_fov_factor)/1024);
+   p3d_screen_point p;
+
+   //Same scale horizontally and vertically --> square pixels
+   p.x = RVR_XRES/2+((x-cam.x)*(RVR_XRES/2))/depth;
+   p.y = RVR_YRES/2-((y-cam.y)*(RVR_XRES/2))/depth;
+   p.w = (RVR_P3D_ROAD_WIDTH*(RVR_XRES/2))/depth;
+
+   return p;
+}
+
+static void p3d_segment_draw(const RvR_p3d_segment *seg, p3d_screen_point s0, p3d_screen_point s1)
+{
+   int y0 = RvR_max(0,s1.y);
+   int y1 = RvR_min(s0.y,p3d_clip_y);
+   int dy = s0.y-s1.y;
+
+   //Interpolate road center and width per scanline, 1024 = 1 pixel
+   RvR_fix22 step_x = ((s0.x-s1.x)*1024)/dy;
+   RvR_fix22 step_w = ((s0.w-s1.w)*1024)/dy;
+   RvR_fix22 x = s1.x*1024+step_x*(y0-s1.y);
+   RvR_fix22 w = s1.w*1024+step_w*(y0-s1.y);
+
+   uint8_t *row = &RvR_core_framebuffer()[y0*RVR_XRES];
+   for(int y = y0;y<y1;y++,row+=RVR_XRES,x+=step_x,w+=step_w)
+   {
+      int cx = x/1024;
+      int cw = w/1024;
+      int border = cw/8;
+
+      p3d_span(row,0,RVR_XRES,seg->color_grass);
+      p3d_span(row,cx-cw-border,cx+cw+border,seg->color_border);
+      p3d_span(row,cx-cw,cx+cw,seg->color_road);
+
+      if(seg->line>1)
+      {
+         int lane_width = RvR_max(1,cw/32);
+         for(int i = 1;i<seg->line;i++)
+         {
+            int lx = cx-cw+(2*cw*i)/seg->line;
+            p3d_span(row,lx-lane_width/2,lx-lane_width/2+lane_width,seg->color_lane);
+         }
+      }
+   }
+}
+
+static void p3d_span(uint8_t *row, int x0, int x1, uint8_t color)
+{
+   x0 = RvR_max(0,x0);
+   x1 = RvR_min(RVR_XRES,x1);
+   if(x0<x1)
+      memset(row+x0,color,x1-x0);
 }
+
+static void p3d_sprite_project(const RvR_p3d_sprite *sp, p3d_screen_point s, int clip)
+{
+   //Sprite tagged as invisible --> don't draw
+   if(sp->flags&1)
+      return;
+
+   RvR_texture *texture = RvR_texture_get(sp->tex);
+   int width = (texture->width*16*s.w)/RVR_P3D_ROAD_WIDTH;
+   int height = (texture->height*16*s.w)/RVR_P3D_ROAD_WIDTH;
+   if(width<=0||height<=0)
+      return;
+
+   p3d_sprite_draw p = {0};
+   p.tex = sp->tex;
+   p.flags = sp->flags;
+   p.x0 = s.x+(sp->pos*s.w)/RVR_P3D_ROAD_WIDTH-width/2;
+   p.x1 = p.x0+width;
+   p.y0 = s.y-height;
+   p.y1 = s.y;
+   p.clip = clip;
+   p.step_u = (texture->width*65536)/width;
+   p.step_v = (texture->height*65536)/height;
+
+   //Completely out of sight
+   if(p.x1<=0||p.x0>=RVR_XRES||p.y1<=0||p.y0>=RvR_min(RVR_YRES,clip))
+      return;
+
+   p3d_stack_sprite_push(&p3d_sprites,p);
+}
+
+RvR_stack_function(p3d_sprite_draw,p3d_stack_sprite,64,64,static inline)
+RvR_pool_function(RvR_p3d_sprite,p3d_pool_sprite,7,static inline)
 //-------------------------------------
@@ -26,10 +26,85 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 //-------------------------------------
 
 //Variables
+static RvR_p3d_segment *p3d_segments = NULL;
+static int32_t p3d_segment_count = 0;
 //-------------------------------------
 
 //Function prototypes
 //-------------------------------------
 
 //Function implementations
+
+void RvR_p3d_track_create(int32_t segments)
+{
+   if(p3d_segments!=NULL)
+      RvR_free(p3d_segments);
+
+   p3d_segment_count = RvR_max(1,segments);
+   p3d_segments = RvR_malloc(sizeof(*p3d_segments)*p3d_segment_count);
+   memset(p3d_segments,0,sizeof(*p3d_segments)*p3d_segment_count);
+
+   for(int32_t i = 0;i<p3d_segment_count;i++)
+   {
+      p3d_segments[i].p0.z = i*RVR_P3D_SEGMENT_LENGTH;
+      p3d_segments[i].p1.z = (i+1)*RVR_P3D_SEGMENT_LENGTH;
+      p3d_segments[i].sprite_first = -1;
+   }
+}
+
+int32_t RvR_p3d_track_length()
+{
+   return p3d_segment_count;
+}
+
+RvR_fix22 RvR_p3d_track_height(RvR_fix22 z)
+{
+   if(p3d_segment_count==0)
+      return 0;
+
+   RvR_p3d_segment *seg = RvR_p3d_segment_get(RvR_div_round_down(z,RVR_P3D_SEGMENT_LENGTH));
+   RvR_fix22 t = ((z%RVR_P3D_SEGMENT_LENGTH+RVR_P3D_SEGMENT_LENGTH)%RVR_P3D_SEGMENT_LENGTH*1024)/RVR_P3D_SEGMENT_LENGTH;
+
+   return seg->p0.y+((seg->p1.y-seg->p0.y)*t)/1024;
+}
+
+RvR_p3d_segment *RvR_p3d_segment_get(int32_t segment)
+{
+   if(p3d_segment_count==0)
+      return NULL;
+
+   segment%=p3d_segment_count;
+   if(segment<0)
+      segment+=p3d_segment_count;
+
+   return &p3d_segments[segment];
+}
+
+void RvR_p3d_segment_sprite_add(int32_t segment, int32_t sprite)
+{
+   RvR_p3d_segment *seg = RvR_p3d_segment_get(segment);
+   RvR_p3d_sprite *sp = RvR_p3d_sprite_get(sprite);
+   if(seg==NULL||sp==NULL)
+      return;
+
+   sp->next = seg->sprite_first;
+   seg->sprite_first = sprite;
+}
+
+void RvR_p3d_segment_sprite_remove(int32_t segment, int32_t sprite)
+{
+   RvR_p3d_segment *seg = RvR_p3d_segment_get(segment);
+   if(seg==NULL)
+      return;
+
+   int32_t *link = &seg->sprite_first;
+   while(*link>=0&&*link!=sprite)
+      link = &RvR_p3d_sprite_get(*link)->next;
+
+   if(*link==sprite)
+   {
+      *link = RvR_p3d_sprite_get(sprite)->next;
+      RvR_p3d_sprite_get(sprite)->next = -1;
+   }
+}
 //-------------------------------------
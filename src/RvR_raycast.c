@@ -142,6 +142,7 @@ void RvR_ray_cast_multi_hit(RvR_ray ray, RvR_ray_hit_result *hit_results, uint16
       h.cheight = (127*1024)/8;
       h.floor_tex = RvR_ray_map_sky_tex();
       h.ceil_tex = RvR_ray_map_sky_tex();
+      h.shade = 0;
 
       switch(h.direction)
       {
@@ -152,6 +153,7 @@ void RvR_ray_cast_multi_hit(RvR_ray ray, RvR_ray_hit_result *hit_results, uint16
             h.fheight = RvR_ray_map_floor_height_at_us(current_square.x,current_square.y+1);
             h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x,current_square.y+1);
             h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x,h.square.y+1);
+            h.shade = RvR_ray_map_shade_at_us(h.square.x,h.square.y+1);
             h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x,h.square.y+1);
          }
          break;
@@ -162,6 +164,7 @@ void RvR_ray_cast_multi_hit(RvR_ray ray, RvR_ray_hit_result *hit_results, uint16
             h.fheight = RvR_ray_map_floor_height_at_us(current_square.x+1,current_square.y);
             h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x+1,current_square.y);
             h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x+1,h.square.y);
+            h.shade = RvR_ray_map_shade_at_us(h.square.x+1,h.square.y);
             h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x+1,h.square.y);
          }
          break;
@@ -172,6 +175,7 @@ void RvR_ray_cast_multi_hit(RvR_ray ray, RvR_ray_hit_result *hit_results, uint16
             h.fheight = RvR_ray_map_floor_height_at_us(current_square.x,current_square.y-1);
             h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x,current_square.y-1);
             h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x,h.square.y-1);
+            h.shade = RvR_ray_map_shade_at_us(h.square.x,h.square.y-1);
             h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x,h.square.y-1);
          }
          break;
@@ -182,6 +186,7 @@ void RvR_ray_cast_multi_hit(RvR_ray ray, RvR_ray_hit_result *hit_results, uint16
             h.fheight = RvR_ray_map_floor_height_at_us(current_square.x-1,current_square.y);
             h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x-1,current_square.y);
             h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x-1,h.square.y);
+            h.shade = RvR_ray_map_shade_at_us(h.square.x-1,h.square.y);
             h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x-1,h.square.y);
          }
          break;
@@ -356,6 +361,7 @@ void RvR_ray_cast_multi_hit_draw(RvR_ray ray, RvR_ray_hit_result *hit_results, u
          h.cheight = (127*1024)/8;
          h.floor_tex = RvR_ray_map_sky_tex();
          h.ceil_tex = RvR_ray_map_sky_tex();
+         h.shade = 0;
 
          switch(h.direction)
          {
@@ -366,6 +372,7 @@ void RvR_ray_cast_multi_hit_draw(RvR_ray ray, RvR_ray_hit_result *hit_results, u
                h.fheight = RvR_ray_map_floor_height_at_us(current_square.x,current_square.y+1);
                h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x,current_square.y+1);
                h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x,h.square.y+1);
+               h.shade = RvR_ray_map_shade_at_us(h.square.x,h.square.y+1);
                h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x,h.square.y+1);
             }
             break;
@@ -376,6 +383,7 @@ void RvR_ray_cast_multi_hit_draw(RvR_ray ray, RvR_ray_hit_result *hit_results, u
                h.fheight = RvR_ray_map_floor_height_at_us(current_square.x+1,current_square.y);
                h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x+1,current_square.y);
                h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x+1,h.square.y);
+               h.shade = RvR_ray_map_shade_at_us(h.square.x+1,h.square.y);
                h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x+1,h.square.y);
             }
             break;
@@ -386,6 +394,7 @@ void RvR_ray_cast_multi_hit_draw(RvR_ray ray, RvR_ray_hit_result *hit_results, u
                h.fheight = RvR_ray_map_floor_height_at_us(current_square.x,current_square.y-1);
                h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x,current_square.y-1);
                h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x,h.square.y-1);
+               h.shade = RvR_ray_map_shade_at_us(h.square.x,h.square.y-1);
                h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x,h.square.y-1);
             }
             break;
@@ -396,6 +405,7 @@ void RvR_ray_cast_multi_hit_draw(RvR_ray ray, RvR_ray_hit_result *hit_results, u
                h.fheight = RvR_ray_map_floor_height_at_us(current_square.x-1,current_square.y);
                h.cheight = RvR_ray_map_ceiling_height_at_us(current_square.x-1,current_square.y);
                h.floor_tex = RvR_ray_map_floor_tex_at_us(h.square.x-1,h.square.y);
+               h.shade = RvR_ray_map_shade_at_us(h.square.x-1,h.square.y);
                h.ceil_tex = RvR_ray_map_ceil_tex_at_us(h.square.x-1,h.square.y);
             }
             break;
@@ -29,6 +29,7 @@ typedef struct ray_plane
    int32_t max;
    RvR_fix22 height;
    uint16_t tex;
+   uint8_t shade;
    uint16_t start[RVR_XRES+2];
    uint16_t end[RVR_XRES+2];
 
@@ -49,15 +50,19 @@ typedef struct
    uint32_t flags;
    RvR_fix22 angle;
 }ray_sprite;
+
+RvR_pool_type(ray_plane,ray_pool_plane);
+RvR_pool_type(RvR_ray_depth_buffer_entry,ray_pool_depth_buffer_entry);
 //-------------------------------------
 
 //Variables
 static RvR_ray_depth_buffer ray_depth_buffer = {0};
 static ray_plane *ray_planes[128] = {0};
 
-//Linked list pools
-static ray_plane *ray_plane_pool = NULL;
-static RvR_ray_depth_buffer_entry *ray_depth_buffer_entry_pool = NULL;
+//Everything allocated from these is freed at the start of each frame
+static ray_pool_plane ray_plane_pool = {0};
+static ray_pool_depth_buffer_entry ray_depth_buffer_entry_pool = {0};
+static int ray_drawing = 0;
 
 static RvR_fix22 ray_start_floor_height = 0;
 static RvR_fix22 ray_start_ceil_height = 0;
@@ -80,9 +85,9 @@ static RvR_fix22 ray_cos_fov;
 //-------------------------------------
 
 //Function prototypes
-static void ray_plane_add(RvR_fix22 height, uint16_t tex, int x, int y0, int y1);
+static void ray_plane_add(RvR_fix22 height, uint16_t tex, uint8_t shade, int x, int y0, int y1);
 
-static void ray_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, const RvR_texture *texture);
+static void ray_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, uint8_t shade, const RvR_texture *texture);
 static void ray_span_draw_flat(int x0, int x1, int y, uint8_t color);
 
 static int16_t ray_draw_wall(RvR_fix22 y_current, RvR_fix22 y_from, RvR_fix22 y_to, RvR_fix22 limit0, RvR_fix22 limit1, RvR_fix22 height, int16_t increment, RvR_ray_pixel_info *pixel_info, RvR_ray_hit_result *hit);
@@ -96,32 +101,34 @@ static void ray_sprite_draw_floor(ray_sprite *sp);
 static void ray_sprite_draw_billboard(ray_sprite *sp);
 
 static RvR_ray_depth_buffer_entry *ray_depth_buffer_entry_new();
-static void ray_depth_buffer_entry_free(RvR_ray_depth_buffer_entry *ent);
 
 static ray_plane *ray_plane_new();
-static void ray_plane_free(ray_plane *pl);
+static size_t ray_pools_evict(size_t size);
+
+RvR_pool_function_prototype(ray_plane,ray_pool_plane,static inline);
+RvR_pool_function_prototype(RvR_ray_depth_buffer_entry,ray_pool_depth_buffer_entry,static inline);
 //-------------------------------------
 
 //Function implementations
 
 void RvR_ray_draw_begin()
 {
+   if(ray_plane_pool.chunks==NULL)
+      RvR_malloc_evict_register(ray_pools_evict,0,"ray pools");
+   ray_drawing = 1;
+
    //Clear depth buffer
    for(int i = 0;i<RVR_XRES;i++)
    {
-      ray_depth_buffer_entry_free(ray_depth_buffer.floor[i]);
-      ray_depth_buffer_entry_free(ray_depth_buffer.ceiling[i]);
-
       ray_depth_buffer.floor[i] = NULL;
       ray_depth_buffer.ceiling[i] = NULL;
    }
+   ray_pool_depth_buffer_entry_reset(&ray_depth_buffer_entry_pool);
 
    //Clear planes
    for(int i = 0;i<128;i++)
-   {
-      ray_plane_free(ray_planes[i]);
       ray_planes[i] = NULL;
-   }
+   ray_pool_plane_reset(&ray_plane_pool);
 
    //Initialize needed vars
    ray_fov_factor_x = RvR_fix22_tan(RvR_ray_get_fov()/2);
@@ -140,9 +147,11 @@ void RvR_ray_draw_begin()
 
 void RvR_ray_draw_end()
 {
+   RvR_frame_marker mark = RvR_frame_mark();
+   uint8_t *certain = RvR_frame_alloc(sizeof(*certain)*ray_sprite_stack.data_used);
+
    while(ray_sprite_stack.data_used>0)
    {
-      uint8_t certain[ray_sprite_stack.data_used];
       memset(certain,0,sizeof(*certain)*ray_sprite_stack.data_used);
       int16_t far = 0;
       certain[far] = 1;
@@ -182,6 +191,8 @@ void RvR_ray_draw_end()
    }
 
    ray_sprite_stack.data_used = 0;
+   RvR_frame_release(mark);
+   ray_drawing = 0;
 }
 
 RvR_ray_depth_buffer *RvR_ray_draw_depth_buffer()
@@ -523,7 +534,7 @@ void RvR_ray_draw_map()
 #if RVR_RAY_DRAW_PLANES==1
                ray_span_draw_flat(ray_span_start[s0],x-1,s0,(i+1)&255);
 #elif RVR_RAY_DRAW_PLANES==2
-               ray_span_draw_tex(ray_span_start[s0],x-1,s0,pl->height,texture);
+               ray_span_draw_tex(ray_span_start[s0],x-1,s0,pl->height,pl->shade,texture);
 #endif
             }
 
@@ -533,7 +544,7 @@ void RvR_ray_draw_map()
 #if RVR_RAY_DRAW_PLANES==1
                ray_span_draw_flat(ray_span_start[e0],x-1,e0,(i+1)&255);
 #elif RVR_RAY_DRAW_PLANES==2
-               ray_span_draw_tex(ray_span_start[e0],x-1,e0,pl->height,texture);
+               ray_span_draw_tex(ray_span_start[e0],x-1,e0,pl->height,pl->shade,texture);
 #endif
             }
 
@@ -556,7 +567,9 @@ next:
 void RvR_ray_draw_debug(uint8_t index)
 {
    char tmp[128];
-   snprintf(tmp,128,"%03d.%01d ms\n",RvR_core_frametime_average()/10,RvR_core_frametime_average()%10);
+   RvR_telemetry_stats stats;
+   RvR_telemetry_stats_get(&stats);
+   snprintf(tmp,128,"%03d.%01d ms (p99 %03d.%01d ms, %u hitches)\n",RvR_core_frametime_average()/10,RvR_core_frametime_average()%10,stats.frametime.p99/1000,(stats.frametime.p99/100)%10,stats.hitches);
    RvR_draw_string(2,2,1,tmp,index);
 
    for(int i = 0;i<128;i++)
@@ -595,12 +608,12 @@ static int16_t ray_draw_wall(RvR_fix22 y_current, RvR_fix22 y_from, RvR_fix22 y_
    //Sky texture is handled differently and instead added as a plane
    if(increment==-1&&hit->wall_ftex==RvR_ray_map_sky_tex())
    {
-      ray_plane_add(hit->fheight,hit->wall_ftex,pixel_info->position.x,start,end);
+      ray_plane_add(hit->fheight,hit->wall_ftex,0,pixel_info->position.x,start,end);
       return limit;
    }
    else if(increment==1&&hit->wall_ctex==RvR_ray_map_sky_tex())
    {
-      ray_plane_add(hit->cheight,hit->wall_ctex,pixel_info->position.x,start,end);
+      ray_plane_add(hit->cheight,hit->wall_ctex,0,pixel_info->position.x,start,end);
       return limit;
    }
 
@@ -614,7 +627,7 @@ static int16_t ray_draw_wall(RvR_fix22 y_current, RvR_fix22 y_from, RvR_fix22 y_
       texture = RvR_texture_get(hit->wall_ctex);
 
    uint8_t * restrict pix = &RvR_core_framebuffer()[start*RVR_XRES+pixel_info->position.x];
-   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(hit->direction&1)*10+(pixel_info->depth>>9)));
+   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(hit->direction&1)*10+(pixel_info->depth>>9)+hit->shade));
    const uint8_t * restrict tex = &texture->data[(hit->texture_coord>>4)*texture->height];
    RvR_fix22 y_and = (1<<RvR_log2(texture->height))-1;
 
@@ -713,6 +726,7 @@ static void ray_draw_column(RvR_ray_hit_result *hits, int hits_len, uint16_t x,
          h.ceil_tex = RvR_ray_map_sky_tex();
          h.fheight = RvR_fix22_infinity;
          h.cheight = RvR_fix22_infinity;
+         h.shade = 0;
       }
 
       RvR_fix22 limit;
@@ -721,7 +735,7 @@ static void ray_draw_column(RvR_ray_hit_result *hits, int hits_len, uint16_t x,
       limit_f = limit = RvR_clamp(f_z1_screen,c_pos_y+1,RVR_YRES);
       if(f_pos_y>limit)
       {
-         ray_plane_add(h.fheight,h.floor_tex,p.position.x,limit,f_pos_y-1);
+         ray_plane_add(h.fheight,h.floor_tex,h.shade,p.position.x,limit,f_pos_y-1);
          f_pos_y = limit;
       }
 
@@ -729,7 +743,7 @@ static void ray_draw_column(RvR_ray_hit_result *hits, int hits_len, uint16_t x,
       limit_c = limit = RvR_clamp(c_z1_screen,-1,f_pos_y-1);
       if(limit>c_pos_y)
       {
-         ray_plane_add(h.cheight,h.ceil_tex,p.position.x,c_pos_y+1,limit);
+         ray_plane_add(h.cheight,h.ceil_tex,h.shade,p.position.x,c_pos_y+1,limit);
          c_pos_y = limit;
       }
 
@@ -817,7 +831,7 @@ RvR_ray_pixel_info RvR_ray_map_to_screen(RvR_vec3 world_position)
    return result;
 }
 
-static void ray_plane_add(RvR_fix22 height, uint16_t tex, int x, int y0, int y1)
+static void ray_plane_add(RvR_fix22 height, uint16_t tex, uint8_t shade, int x, int y0, int y1)
 {
    x+=1;
    //Div height by 128, since it's usually in these increments
@@ -829,9 +843,12 @@ static void ray_plane_add(RvR_fix22 height, uint16_t tex, int x, int y0, int y1)
       //ray_planes need to have the same height...
       if(height!=pl->height)
          goto next;
-      //... and the same texture to be valid for concatination
+      //... the same texture...
       if(tex!=pl->tex)
          goto next;
+      //... and the same shade to be valid for concatination
+      if(shade!=pl->shade)
+         goto next;
 
       //Additionally the spans collumn needs to be either empty...
       if(pl->start[x]!=UINT16_MAX)
@@ -867,6 +884,7 @@ next:
       pl->max = -1;
       pl->height = height;
       pl->tex = tex;
+      pl->shade = shade;
 
       //Since this is an unsigned int, we can use memset to set all values to 65535 (0xffff)
       memset(pl->start,255,sizeof(pl->start));
@@ -881,7 +899,7 @@ next:
    pl->start[x] = y0;
 }
 
-static void ray_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, const RvR_texture *texture)
+static void ray_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, uint8_t shade, const RvR_texture *texture)
 {
    //Shouldn't happen
    if(x0>=x1)
@@ -901,7 +919,7 @@ static void ray_span_draw_tex(int x0, int x1, int y, RvR_fix22 height, const RvR
    RvR_fix22 ty = -(RvR_ray_get_position().y&1023)*1024-ray_sin*depth+((x0-RVR_XRES/2)*step_y);
 
    uint8_t * restrict pix = &RvR_core_framebuffer()[y*RVR_XRES+x0];
-   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(depth>>9)));
+   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(depth>>9)+shade));
    const uint8_t * restrict tex = texture->data;
    RvR_fix22 x_and = (1<<RvR_log2(texture->width))-1;
    RvR_fix22 y_and = (1<<RvR_log2(texture->height))-1;
@@ -1092,6 +1110,7 @@ static void ray_sprite_draw_wall(ray_sprite *sp)
    RvR_texture *texture = RvR_texture_get(sp->texture);
    int mask = (1<<RvR_log2(texture->height))-1;
    RvR_fix22 scale_vertical = texture->height*16;
+   uint8_t shade = RvR_ray_map_shade_at(sp->p.x/1024,sp->p.y/1024);
    int size0 = RVR_YRES*((scale_vertical*1024)/RvR_non_zero((ray_fov_factor_y*sp->sp0.z)/1024));
    int size1 = RVR_YRES*((scale_vertical*1024)/RvR_non_zero((ray_fov_factor_y*sp->sp1.z)/1024));
    int y0 = sp->sp0.y;
@@ -1191,7 +1210,7 @@ static void ray_sprite_draw_wall(ray_sprite *sp)
 
       tex = &texture->data[texture->height*(u>>20)];
       dst = &RvR_core_framebuffer()[ys*RVR_XRES+i];
-      col = RvR_shade_table(RvR_min(63,depth>>9));
+      col = RvR_shade_table(RvR_min(63,(depth>>9)+shade));
 
       if(sp->flags&32)
       {
@@ -1284,7 +1303,8 @@ static void ray_sprite_draw_billboard(ray_sprite *sp)
    }
 
    //Draw
-   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,depth>>9));
+   uint8_t shade = RvR_ray_map_shade_at(sp->p.x/1024,sp->p.y/1024);
+   const uint8_t * restrict col = RvR_shade_table(RvR_min(63,(depth>>9)+shade));
    uint8_t * restrict dst = NULL;
    const uint8_t * restrict tex = NULL;
    for(int x = x0;x<x1;x++)
@@ -1349,67 +1369,45 @@ static void ray_sprite_draw_billboard(ray_sprite *sp)
 
 static ray_plane *ray_plane_new()
 {
-   if(ray_plane_pool==NULL)
-   {
-      ray_plane *p = RvR_malloc(sizeof(*p)*8);
-      memset(p,0,sizeof(*p)*8);
-
-      for(int i = 0;i<7;i++)
-         p[i].next = &p[i+1];
-      ray_plane_pool = p;
-   }
-
-   ray_plane *p = ray_plane_pool;
-   ray_plane_pool = p->next;
+   ray_plane *p = ray_pool_plane_get(&ray_plane_pool,ray_pool_plane_alloc(&ray_plane_pool));
    p->next = NULL;
 
    return p;
 }
 
-static void ray_plane_free(ray_plane *pl)
-{
-   if(pl==NULL)
-      return;
-
-   //Find last
-   ray_plane *last = pl;
-   while(last->next!=NULL)
-      last = last->next;
-
-   last->next = ray_plane_pool;
-   ray_plane_pool = pl;
-}
-
 static RvR_ray_depth_buffer_entry *ray_depth_buffer_entry_new()
 {
-   if(ray_depth_buffer_entry_pool==NULL)
-   {
-      RvR_ray_depth_buffer_entry *e = RvR_malloc(sizeof(*e)*256);
-      memset(e,0,sizeof(*e)*256);
-
-      for(int i = 0;i<255;i++)
-         e[i].next = &e[i+1];
-      ray_depth_buffer_entry_pool = e;
-   }
-
-   RvR_ray_depth_buffer_entry *e = ray_depth_buffer_entry_pool;
-   ray_depth_buffer_entry_pool = e->next;
+   RvR_ray_depth_buffer_entry *e = ray_pool_depth_buffer_entry_get(&ray_depth_buffer_entry_pool,ray_pool_depth_buffer_entry_alloc(&ray_depth_buffer_entry_pool));
    e->next = NULL;
 
    return e;
 }
 
-static void ray_depth_buffer_entry_free(RvR_ray_depth_buffer_entry *ent)
+//The pools can only be released between frames,
+//the depth buffer is empty afterwards
+static size_t ray_pools_evict(size_t size)
 {
-   if(ent==NULL)
-      return;
+   (void)size;
 
-   //Find last
-   RvR_ray_depth_buffer_entry *last = ent;
-   while(last->next!=NULL)
-      last = last->next;
+   if(ray_drawing)
+      return 0;
 
-   last->next = ray_depth_buffer_entry_pool;
-   ray_depth_buffer_entry_pool = ent;
+   size_t released = sizeof(**ray_plane_pool.chunks)*ray_plane_pool.capacity+
+                     sizeof(**ray_depth_buffer_entry_pool.chunks)*ray_depth_buffer_entry_pool.capacity;
+
+   for(int i = 0;i<RVR_XRES;i++)
+   {
+      ray_depth_buffer.floor[i] = NULL;
+      ray_depth_buffer.ceiling[i] = NULL;
+   }
+   for(int i = 0;i<128;i++)
+      ray_planes[i] = NULL;
+   ray_pool_plane_destroy(&ray_plane_pool);
+   ray_pool_depth_buffer_entry_destroy(&ray_depth_buffer_entry_pool);
+
+   return released;
 }
+
+RvR_pool_function(ray_plane,ray_pool_plane,3,static inline)
+RvR_pool_function(RvR_ray_depth_buffer_entry,ray_pool_depth_buffer_entry,8,static inline)
 //-------------------------------------
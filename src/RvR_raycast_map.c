@@ -52,12 +52,14 @@ void RvR_ray_map_create(uint16_t width, uint16_t height)
    ray_map.ceil_tex = RvR_malloc(ray_map.width*ray_map.height*sizeof(*ray_map.ceil_tex));
    ray_map.wall_ftex = RvR_malloc(ray_map.width*ray_map.height*sizeof(*ray_map.wall_ftex));
    ray_map.wall_ctex = RvR_malloc(ray_map.width*ray_map.height*sizeof(*ray_map.wall_ctex));
+   ray_map.shade = RvR_malloc(ray_map.width*ray_map.height*sizeof(*ray_map.shade));
 
    memset(ray_map.floor,0,ray_map.width*ray_map.height*sizeof(*ray_map.floor));
    memset(ray_map.floor_tex,0,ray_map.width*ray_map.height*sizeof(*ray_map.floor_tex));
    memset(ray_map.ceil_tex,0,ray_map.width*ray_map.height*sizeof(*ray_map.ceil_tex));
    memset(ray_map.wall_ftex,0,ray_map.width*ray_map.height*sizeof(*ray_map.wall_ftex));
    memset(ray_map.wall_ctex,0,ray_map.width*ray_map.height*sizeof(*ray_map.wall_ctex));
+   memset(ray_map.shade,0,ray_map.width*ray_map.height*sizeof(*ray_map.shade));
 
    for(int y = 0;y<ray_map.height;y++)
       for(int x = 0;x<ray_map.width;x++)
@@ -78,6 +80,8 @@ void RvR_ray_map_free()
       RvR_free(ray_map.wall_ftex);
    if(ray_map.wall_ctex!=NULL)
       RvR_free(ray_map.wall_ctex);
+   if(ray_map.shade!=NULL)
+      RvR_free(ray_map.shade);
    if(ray_map.sprites!=NULL)
       RvR_free(ray_map.sprites);
 
@@ -87,6 +91,7 @@ void RvR_ray_map_free()
    ray_map.ceiling = NULL;
    ray_map.wall_ftex = NULL;
    ray_map.wall_ctex = NULL;
+   ray_map.shade = NULL;
    ray_map.sprites = NULL;
    ray_map.width = 0;
    ray_map.height = 0;
@@ -142,8 +147,9 @@ void RvR_ray_map_load_rw(RvR_rw *rw)
    RvR_error_check(rw!=NULL,"RvR_ray_map_load_rw","argument 'rw' must be non-NULL\n");
 
    //Read and check version
+   //Version 0 maps have no shading, version 1 added it
    uint16_t version = RvR_rw_read_u16(rw);
-   RvR_error_check(version==0,"RvR_ray_map_load_rw","Invalid version '%d', expected version '0'\n",version);
+   RvR_error_check(version<=1,"RvR_ray_map_load_rw","Invalid version '%d', expected version '0' or '1'\n",version);
 
    //Read sky texture
    uint16_t sky_tex = RvR_rw_read_u16(rw);
@@ -168,6 +174,8 @@ void RvR_ray_map_load_rw(RvR_rw *rw)
    for(int32_t i = 0;i<tile_count;i++) ray_map.ceil_tex[i] = RvR_rw_read_u16(rw);
    for(int32_t i = 0;i<tile_count;i++) ray_map.wall_ftex[i] = RvR_rw_read_u16(rw);
    for(int32_t i = 0;i<tile_count;i++) ray_map.wall_ctex[i] = RvR_rw_read_u16(rw);
+   if(version>=1)
+      for(int32_t i = 0;i<tile_count;i++) ray_map.shade[i] = RvR_min(63,RvR_rw_read_u8(rw));
 
    //Read sprites
    for(unsigned i = 0;i<ray_map.sprite_count;i++)
@@ -204,6 +212,7 @@ void RvR_ray_map_save(const char *path)
    size+=ray_map.width*ray_map.height*2; //ray_map.ceil_tex
    size+=ray_map.width*ray_map.height*2; //ray_map.wall_ftex
    size+=ray_map.width*ray_map.height*2; //ray_map.wall_ctex
+   size+=ray_map.width*ray_map.height*1; //ray_map.shade
    size+=ray_map.sprite_count*sizeof(*ray_map.sprites);
 
    uint8_t *mem = RvR_malloc(size);
@@ -211,7 +220,7 @@ void RvR_ray_map_save(const char *path)
    RvR_rw_init_mem(&rw,mem,size,size);
 
    //version
-   RvR_rw_write_u16(&rw,0);
+   RvR_rw_write_u16(&rw,1);
 
    //sky texture
    RvR_rw_write_u16(&rw,ray_map.sky_tex);
@@ -247,6 +256,10 @@ void RvR_ray_map_save(const char *path)
    for(int i = 0;i<ray_map.width*ray_map.height;i++)
       RvR_rw_write_u16(&rw,ray_map.wall_ctex[i]);
 
+   //shade
+   for(int i = 0;i<ray_map.width*ray_map.height;i++)
+      RvR_rw_write_u8(&rw,ray_map.shade[i]);
+
    //sprites
    for(unsigned i = 0;i<ray_map.sprite_count;i++)
    {
@@ -355,6 +368,14 @@ uint16_t RvR_ray_map_wall_ctex_at(int16_t x, int16_t y)
    return 0;
 }
 
+uint8_t RvR_ray_map_shade_at(int16_t x, int16_t y)
+{
+   if(x>=0&&x<ray_map.width&&y>=0&&y<ray_map.height)
+      return ray_map.shade[y*ray_map.width+x]; 
+
+   return 0;
+}
+
 RvR_fix22 RvR_ray_map_floor_height_at_us(int16_t x, int16_t y)
 {
    return ray_map.floor[y*ray_map.width+x];
@@ -385,6 +406,11 @@ uint16_t RvR_ray_map_wall_ctex_at_us(int16_t x, int16_t y)
    return ray_map.wall_ctex[y*ray_map.width+x]; 
 }
 
+uint8_t RvR_ray_map_shade_at_us(int16_t x, int16_t y)
+{
+   return ray_map.shade[y*ray_map.width+x]; 
+}
+
 void RvR_ray_map_floor_height_set(int16_t x, int16_t y, RvR_fix22 height)
 {
    if(x>=0&&x<ray_map.width&&y>=0&&y<ray_map.height)
@@ -420,4 +446,10 @@ void RvR_ray_map_wall_ctex_set(int16_t x, int16_t y, uint16_t tex)
    if(x>=0&&x<ray_map.width&&y>=0&&y<ray_map.height)
       ray_map.wall_ctex[y*ray_map.width+x] = tex;
 }
+
+void RvR_ray_map_shade_set(int16_t x, int16_t y, uint8_t shade)
+{
+   if(x>=0&&x<ray_map.width&&y>=0&&y<ray_map.height)
+      ray_map.shade[y*ray_map.width+x] = RvR_min(63,shade);
+}
 //-------------------------------------
@@ -381,7 +381,6 @@ size_t RvR_rw_write(RvR_rw *rw, const void *buffer, size_t size, size_t count)
    }
    else if(rw->type==RVR_RW_DYN_MEM)
    {
-      uint8_t *buff_out = rw->as.dmem.mem;
       const uint8_t *buff_in = buffer;
 
       for(size_t i = 0;i<count;i++)
@@ -392,9 +391,11 @@ size_t RvR_rw_write(RvR_rw *rw, const void *buffer, size_t size, size_t count)
             rw->as.dmem.mem = RvR_realloc(rw->as.dmem.mem,rw->as.dmem.size);
          }
 
-         rw->as.dmem.csize = RvR_max(rw->as.dmem.csize,rw->as.dmem.pos);
+         //Buffer might have moved
+         uint8_t *buff_out = rw->as.dmem.mem;
          memcpy(buff_out+rw->as.dmem.pos,buff_in+(i*size),size);
          rw->as.dmem.pos+=size;
+         rw->as.dmem.csize = RvR_max(rw->as.dmem.csize,rw->as.dmem.pos);
       }
 
       return count;
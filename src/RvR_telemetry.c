@@ -0,0 +1,151 @@
+/*
+RvnicRaven retro game engine
+
+Written in 2021,2022 by Lukas Holzbeierlein (Captain4LK) email: captain4lk [at] tutanota [dot] com
+
+To the extent possible under law, the author(s) have dedicated all copyright and related and neighboring rights to this software to the public domain worldwide. This software is distributed without any warranty.
+
+You should have received a copy of the CC0 Public Domain Dedication along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+//External includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+//-------------------------------------
+
+//Internal includes
+#include "RvnicRaven.h"
+//-------------------------------------
+
+//#defines
+//-------------------------------------
+
+//Typedefs
+typedef struct
+{
+   uint32_t frame;
+   int32_t frametime;
+   int32_t delta;
+}telemetry_entry;
+//-------------------------------------
+
+//Variables
+static telemetry_entry telemetry_ring[RVR_TELEMETRY_FRAMES];
+static uint32_t telemetry_count = 0; //Total frames recorded, ring holds the last RVR_TELEMETRY_FRAMES
+static uint32_t telemetry_hitches = 0;
+static int32_t telemetry_hitch_threshold = 2*(1000000/RVR_FPS);
+static int32_t telemetry_sorted[RVR_TELEMETRY_FRAMES];
+
+static char telemetry_exit_path[512];
+static int telemetry_exit_registered = 0;
+//-------------------------------------
+
+//Function prototypes
+static void telemetry_percentiles(RvR_telemetry_percentiles *p, int frames, int delta);
+static int telemetry_cmp(const void *a, const void *b);
+static void telemetry_exit();
+//-------------------------------------
+
+//Function implementations
+
+void RvR_telemetry_record(uint32_t frame, int32_t frametime, int32_t delta)
+{
+   telemetry_entry *e = &telemetry_ring[telemetry_count%RVR_TELEMETRY_FRAMES];
+   e->frame = frame;
+   e->frametime = frametime;
+   e->delta = delta;
+   telemetry_count++;
+
+   if(delta>telemetry_hitch_threshold)
+      telemetry_hitches++;
+}
+
+void RvR_telemetry_reset()
+{
+   telemetry_count = 0;
+   telemetry_hitches = 0;
+}
+
+void RvR_telemetry_hitch_threshold(int32_t threshold)
+{
+   telemetry_hitch_threshold = threshold;
+}
+
+//Statistics cover the frames currently in the ring
+void RvR_telemetry_stats_get(RvR_telemetry_stats *stats)
+{
+   int frames = RvR_min(telemetry_count,RVR_TELEMETRY_FRAMES);
+
+   memset(stats,0,sizeof(*stats));
+   stats->frames = frames;
+   stats->hitches_total = telemetry_hitches;
+
+   for(int i = 0;i<frames;i++)
+      stats->hitches+=telemetry_ring[i].delta>telemetry_hitch_threshold;
+
+   telemetry_percentiles(&stats->frametime,frames,0);
+   telemetry_percentiles(&stats->delta,frames,1);
+}
+
+void RvR_telemetry_csv(const char *path)
+{
+   RvR_rw rw;
+   RvR_rw_init_path(&rw,path,"w");
+   if(!RvR_rw_valid(&rw))
+      return;
+
+   //Oldest frame first
+   int frames = RvR_min(telemetry_count,RVR_TELEMETRY_FRAMES);
+   uint32_t first = telemetry_count-frames;
+   RvR_rw_printf(&rw,"frame,frametime_us,delta_us,hitch\n");
+   for(int i = 0;i<frames;i++)
+   {
+      telemetry_entry *e = &telemetry_ring[(first+i)%RVR_TELEMETRY_FRAMES];
+      RvR_rw_printf(&rw,"%u,%d,%d,%d\n",e->frame,e->frametime,e->delta,e->delta>telemetry_hitch_threshold);
+   }
+
+   RvR_rw_close(&rw);
+}
+
+void RvR_telemetry_csv_at_exit(const char *path)
+{
+   snprintf(telemetry_exit_path,512,"%s",path);
+
+   if(!telemetry_exit_registered)
+   {
+      atexit(telemetry_exit);
+      telemetry_exit_registered = 1;
+   }
+}
+
+static void telemetry_percentiles(RvR_telemetry_percentiles *p, int frames, int delta)
+{
+   if(frames==0)
+      return;
+
+   for(int i = 0;i<frames;i++)
+      telemetry_sorted[i] = delta?telemetry_ring[i].delta:telemetry_ring[i].frametime;
+   qsort(telemetry_sorted,frames,sizeof(*telemetry_sorted),telemetry_cmp);
+
+   p->p50 = telemetry_sorted[(frames*50)/100];
+   p->p95 = telemetry_sorted[(frames*95)/100];
+   p->p99 = telemetry_sorted[(frames*99)/100];
+   p->max = telemetry_sorted[frames-1];
+}
+
+static int telemetry_cmp(const void *a, const void *b)
+{
+   int32_t ta = *((const int32_t *)a);
+   int32_t tb = *((const int32_t *)b);
+
+   return (ta>tb)-(ta<tb);
+}
+
+static void telemetry_exit()
+{
+   if(telemetry_exit_path[0]!='\0')
+      RvR_telemetry_csv(telemetry_exit_path);
+}
+//-------------------------------------
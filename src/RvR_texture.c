@@ -25,6 +25,7 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 typedef struct
 {
    int32_t last_access;
+   uint32_t last_frame;
    uint16_t tex;
 }Texture_cache_entry;
 //-------------------------------------
@@ -43,6 +44,8 @@ static struct
 
 //Function prototypes
 static void texture_load(uint16_t id);
+static void texture_cache_remove(int index);
+static size_t texture_evict(size_t size);
 //-------------------------------------
 
 //Function implementations
@@ -57,6 +60,7 @@ RvR_texture *RvR_texture_get(uint16_t id)
       return textures[id];
 
    texture_cache.cache[cache_id].last_access = texture_last_access++;
+   texture_cache.cache[cache_id].last_frame = RvR_core_frame();
    if(texture_last_access==INT32_MAX)
    {
 #if RVR_TEXTURE_DEBUG
@@ -82,6 +86,7 @@ static void texture_load(uint16_t id)
       texture_cache.cache_used = 0;
       texture_cache.cache = RvR_malloc(sizeof(*texture_cache.cache)*RVR_TEXTURE_MAX);
       memset(texture_cache.cache,0,sizeof(*texture_cache.cache)*RVR_TEXTURE_MAX);
+      RvR_malloc_evict_register(texture_evict,20,"textures");
    }
    if(textures==NULL)
    {
@@ -91,8 +96,6 @@ static void texture_load(uint16_t id)
       memset(textures_cache,0,sizeof(*textures_cache)*(UINT16_MAX+1));
    }
 
-   int index_new = texture_cache.cache_used;
-
    //Cache full --> delete 'oldest' texture
    if(texture_cache.cache_used==RVR_TEXTURE_MAX)
    {
@@ -112,18 +115,7 @@ static void texture_load(uint16_t id)
       RvR_log("unloading texture %d\n",texture_cache.cache[tex_old_index].tex);
 #endif
       
-      //Delete texture
-      int tex_index = texture_cache.cache[tex_old_index].tex;
-      if(textures[tex_index]!=NULL)
-         RvR_free(textures[tex_index]);
-      textures[tex_index] = NULL;
-      
-
-      index_new = tex_old_index;
-   }
-   else
-   {
-      texture_cache.cache_used++;
+      texture_cache_remove(tex_old_index);
    }
 
 #if RVR_TEXTURE_DEBUG
@@ -154,8 +146,13 @@ static void texture_load(uint16_t id)
    textures[id]->height = height;
    for(int i = 0;i<textures[id]->width*textures[id]->height;i++)
       textures[id]->data[i] = RvR_rw_read_u8(&rw);
+
+   //Allocating might have evicted textures,
+   //so the slot can only be picked now
+   int index_new = texture_cache.cache_used++;
    textures_cache[id] = index_new;
    texture_cache.cache[index_new].tex = id;
+   texture_cache.cache[index_new].last_frame = RvR_core_frame();
 
    RvR_rw_close(&rw);
 
@@ -163,6 +160,54 @@ static void texture_load(uint16_t id)
    RvR_free(mem_decomp);
 }
 
+//Moves the last entry into the freed slot
+static void texture_cache_remove(int index)
+{
+   int tex = texture_cache.cache[index].tex;
+   if(textures[tex]!=NULL)
+      RvR_free(textures[tex]);
+   textures[tex] = NULL;
+
+   texture_cache.cache_used--;
+   texture_cache.cache[index] = texture_cache.cache[texture_cache.cache_used];
+   textures_cache[texture_cache.cache[index].tex] = index;
+}
+
+//Unloads the least recently used textures, except the ones used
+//during the current frame, since pointers to those might still be held
+static size_t texture_evict(size_t size)
+{
+   size_t released = 0;
+   uint32_t frame = RvR_core_frame();
+
+   while(released<size)
+   {
+      int oldest = -1;
+      for(unsigned i = 0;i<texture_cache.cache_used;i++)
+      {
+         if(texture_cache.cache[i].last_frame==frame)
+            continue;
+         if(oldest==-1||texture_cache.cache[i].last_access<texture_cache.cache[oldest].last_access)
+            oldest = i;
+      }
+
+      if(oldest==-1)
+         break;
+
+      RvR_texture *tex = textures[texture_cache.cache[oldest].tex];
+      if(tex!=NULL)
+         released+=sizeof(*tex)+sizeof(*tex->data)*tex->width*tex->height;
+
+#if RVR_TEXTURE_DEBUG
+      RvR_log("evicting texture %d\n",texture_cache.cache[oldest].tex);
+#endif
+
+      texture_cache_remove(oldest);
+   }
+
+   return released;
+}
+
 void RvR_texture_create(uint16_t id, int width, int height)
 {
    if(textures==NULL)
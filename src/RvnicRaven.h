@@ -20,8 +20,38 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 #define RVR_YRES 480
 
 //Fps, RvnicRaven must use a fixed timestep
+//Games rendering at a different rate (RvR_core_fps())
+//run RvR_core_ticks() updates per frame at this rate
 #define RVR_FPS 30
 
+//Amount of frames kept for frametime statistics
+#define RVR_TELEMETRY_FRAMES 4096
+
+//Frames queued for writing while capturing, frames get dropped if all are in use
+#define RVR_CAPTURE_BUFFERS 8
+
+//Size of the per frame scratch arena, see RvR_frame_alloc()
+#define RVR_FRAME_ARENA (1<<20)
+
+//Minimum size of the regions RvR_malloc() adds to its heap once the
+//memory passed to RvR_malloc_init() runs out, 0 disables growing
+#define RVR_MALLOC_GROW (1<<24)
+
+//Track allocations per call site, RvR_malloc() and RvR_realloc() become
+//macros recording __FILE__ and __LINE__, see RvR_malloc_profile_report()
+#ifndef RVR_MALLOC_PROFILE
+#define RVR_MALLOC_PROFILE 0
+#endif
+
+//Maximum amount of call sites tracked while profiling, must be a power of two
+#define RVR_MALLOC_PROFILE_SITES 1024
+
+//Maximum amount of job system worker threads
+#define RVR_JOB_THREADS_MAX 16
+
+//Size of each job queue, jobs submitted to a full queue run immediately
+#define RVR_JOB_QUEUE 256
+
 //Maximum amount of textures loaded at once
 #define RVR_TEXTURE_MAX 256
 
@@ -30,6 +60,11 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 
 //Unroll some loops
 #define RVR_UNROLL 1
+
+//Use the headless backend instead of SDL2 (e.g. compile with -DRVR_BACKEND_NULL=1)
+#ifndef RVR_BACKEND_NULL
+#define RVR_BACKEND_NULL 0
+#endif
 //-------------------------------------
 
 //Constants
@@ -61,11 +96,45 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 
 //Macro functions
 //The beautiful abomination
+//Local instances should use the prefix "static inline", so unused functions don't warn,
+//the *_function() macros expand to definitions and take no trailing ';'
 //Stack/dynamic array implementation
 #define RvR_stack_type(type,name) typedef struct { type *data; unsigned data_size; unsigned data_used; }name
-#define RvR_stack_function_prototype(type,name,prefix) prefix type name##_pop(name *st); prefix void name##_push(name *st, type v); prefix void name##_clear(name *st); prefix void name##_free(name *st); prefix int name##_empty(const name *st)
-//TODO: handle non-growing stacks in _push
-#define RvR_stack_function(type,name,grow,min_size,prefix) prefix type name##_pop(name *st) { if(st->data==NULL||st->data_used==0) return (type){0}; return st->data[--st->data_used]; } prefix void name##_push(name *st, type v) { if(st->data==NULL) { st->data_size = min_size; st->data = RvR_malloc(sizeof(*st->data)*st->data_size); } st->data[st->data_used++] = v; if(st->data_used==st->data_size) { st->data_size+=grow; st->data = RvR_realloc(st->data,sizeof(*st->data)*st->data_size); } } prefix void name##_clear(name *st) { st->data_used = 0; } prefix void name##_free(name *st) { if(st->data==NULL) return; RvR_free(st->data); st->data = NULL; st->data_used = 0; st->data_size = 0; } prefix int name##_empty(const name *st) { return st->data_used==0; }
+#define RvR_stack_function_prototype(type,name,prefix) prefix type name##_pop(name *st); prefix void name##_push(name *st, type v); prefix void name##_reserve(name *st, unsigned size); prefix void name##_shrink(name *st); prefix void name##_clear(name *st); prefix void name##_free(name *st); prefix int name##_empty(const name *st)
+//Starts at min_size elements and grows by half its size (at least grow elements) once full
+//_reserve makes room for size elements, _shrink gives unused memory back
+#define RvR_stack_function(type,name,grow,min_size,prefix) prefix type name##_pop(name *st) { if(st->data==NULL||st->data_used==0) return (type){0}; return st->data[--st->data_used]; } prefix void name##_push(name *st, type v) { if(st->data_used==st->data_size) name##_reserve(st,st->data_size==0?RvR_max((min_size),1):st->data_size+RvR_max(st->data_size/2+1,(grow))); st->data[st->data_used++] = v; } prefix void name##_reserve(name *st, unsigned size) { if(size<=st->data_size) return; st->data = RvR_realloc(st->data,sizeof(*st->data)*size); st->data_size = size; } prefix void name##_shrink(name *st) { if(st->data_used==st->data_size) return; if(st->data_used==0) { name##_free(st); return; } st->data = RvR_realloc(st->data,sizeof(*st->data)*st->data_used); st->data_size = st->data_used; } prefix void name##_clear(name *st) { st->data_used = 0; } prefix void name##_free(name *st) { if(st->data==NULL) return; RvR_free(st->data); st->data = NULL; st->data_used = 0; st->data_size = 0; } prefix int name##_empty(const name *st) { return st->data_used==0; }
+
+//Fixed size object pool, growing by chunks of (1<<chunk_log) elements
+//Elements are referred to by index, pointers from _get stay valid since chunks never move
+//_alloc doesn't clear the element, _reset frees all elements at once (keeping the memory)
+//used, capacity and peak (highest amount used at once) can be read directly
+#define RvR_pool_type(type,name) typedef union { type value; int32_t next; }name##_slot; typedef struct { name##_slot **chunks; int32_t chunk_count; int32_t free; int32_t used; int32_t capacity; int32_t peak; }name
+#define RvR_pool_function_prototype(type,name,prefix) prefix int32_t name##_alloc(name *p); prefix type *name##_get(name *p, int32_t index); prefix void name##_free(name *p, int32_t index); prefix void name##_reset(name *p); prefix void name##_destroy(name *p)
+#define RvR_pool_function(type,name,chunk_log,prefix) static inline void name##_reset_range(name *p, int32_t first); prefix int32_t name##_alloc(name *p) { if(p->free==0) { p->chunks = RvR_realloc(p->chunks,sizeof(*p->chunks)*(p->chunk_count+1)); p->chunks[p->chunk_count] = RvR_malloc(sizeof(**p->chunks)<<(chunk_log)); p->chunk_count++; p->capacity+=1<<(chunk_log); name##_reset_range(p,p->capacity-(1<<(chunk_log))); } int32_t index = p->free-1; p->free = p->chunks[index>>(chunk_log)][index&((1<<(chunk_log))-1)].next; p->used++; if(p->used>p->peak) p->peak = p->used; return index; } prefix type *name##_get(name *p, int32_t index) { return &p->chunks[index>>(chunk_log)][index&((1<<(chunk_log))-1)].value; } prefix void name##_free(name *p, int32_t index) { p->chunks[index>>(chunk_log)][index&((1<<(chunk_log))-1)].next = p->free; p->free = index+1; p->used--; } prefix void name##_reset(name *p) { p->free = 0; p->used = 0; name##_reset_range(p,0); } prefix void name##_destroy(name *p) { for(int32_t i = 0;i<p->chunk_count;i++) RvR_free(p->chunks[i]); RvR_free(p->chunks); p->chunks = NULL; p->chunk_count = 0; p->free = 0; p->used = 0; p->capacity = 0; } static inline void name##_reset_range(name *p, int32_t first) { for(int32_t i = p->capacity-1;i>=first;i--) { p->chunks[i>>(chunk_log)][i&((1<<(chunk_log))-1)].next = p->free; p->free = i+1; } }
+
+//Ring buffer (fifo), starts at min_size elements and doubles once full, min_size must be a power of two
+//_peek returns the element index places from the front (NULL if out of range)
+#define RvR_ring_type(type,name) typedef struct { type *data; unsigned size; unsigned head; unsigned tail; }name
+#define RvR_ring_function_prototype(type,name,prefix) prefix void name##_push(name *r, type v); prefix type name##_pop(name *r); prefix type *name##_peek(name *r, unsigned index); prefix unsigned name##_count(const name *r); prefix int name##_empty(const name *r); prefix void name##_clear(name *r); prefix void name##_free(name *r)
+#define RvR_ring_function(type,name,min_size,prefix) prefix void name##_push(name *r, type v) { if(r->tail-r->head==r->size) { unsigned size = r->size==0?(min_size):r->size*2; type *data = RvR_malloc(sizeof(*data)*size); for(unsigned i = 0;i<r->size;i++) data[i] = r->data[(r->head+i)&(r->size-1)]; if(r->data!=NULL) RvR_free(r->data); r->data = data; r->tail-=r->head; r->head = 0; r->size = size; } r->data[r->tail++&(r->size-1)] = v; } prefix type name##_pop(name *r) { if(r->tail==r->head) return (type){0}; return r->data[r->head++&(r->size-1)]; } prefix type *name##_peek(name *r, unsigned index) { if(index>=r->tail-r->head) return NULL; return &r->data[(r->head+index)&(r->size-1)]; } prefix unsigned name##_count(const name *r) { return r->tail-r->head; } prefix int name##_empty(const name *r) { return r->tail==r->head; } prefix void name##_clear(name *r) { r->head = 0; r->tail = 0; } prefix void name##_free(name *r) { if(r->data!=NULL) RvR_free(r->data); r->data = NULL; r->size = 0; r->head = 0; r->tail = 0; }
+
+//Hash map, open addressing with linear probing, starts at min_size entries (a power of two)
+//and doubles once 3/4 are in use. hash(const key *) returns an uint32_t,
+//equal(const key *, const key *) non-zero if both keys are equal
+//Pointers returned by _get and _set stay valid until the next _set
+//Entries can be iterated directly, state is 1 for entries in use
+#define RvR_map_type(key,value,name) typedef struct { key k; value v; uint8_t state; }name##_entry; typedef struct { name##_entry *entries; unsigned size; unsigned used; unsigned removed; }name
+#define RvR_map_function_prototype(key,value,name,prefix) prefix value *name##_get(const name *m, key k); prefix value *name##_set(name *m, key k, value v); prefix int name##_remove(name *m, key k); prefix void name##_clear(name *m); prefix void name##_free(name *m)
+#define RvR_map_function(key,value,name,hash,equal,min_size,prefix) static inline name##_entry *name##_slot(const name *m, const key *k, int insert); static inline void name##_grow(name *m); prefix value *name##_get(const name *m, key k) { if(m->used==0) return NULL; name##_entry *e = name##_slot(m,&k,0); return e==NULL?NULL:&e->v; } prefix value *name##_set(name *m, key k, value v) { if((m->used+m->removed+1)*4>m->size*3) name##_grow(m); name##_entry *e = name##_slot(m,&k,1); if(e->state!=1) { if(e->state==2) m->removed--; e->state = 1; e->k = k; m->used++; } e->v = v; return &e->v; } prefix int name##_remove(name *m, key k) { if(m->used==0) return 0; name##_entry *e = name##_slot(m,&k,0); if(e==NULL) return 0; e->state = 2; m->used--; m->removed++; return 1; } prefix void name##_clear(name *m) { for(unsigned i = 0;i<m->size;i++) m->entries[i].state = 0; m->used = 0; m->removed = 0; } prefix void name##_free(name *m) { if(m->entries!=NULL) RvR_free(m->entries); m->entries = NULL; m->size = 0; m->used = 0; m->removed = 0; } static inline name##_entry *name##_slot(const name *m, const key *k, int insert) { name##_entry *removed = NULL; for(unsigned i = (hash(k))&(m->size-1);;i = (i+1)&(m->size-1)) { name##_entry *e = &m->entries[i]; if(e->state==0) return insert?(removed!=NULL?removed:e):NULL; if(e->state==2) { if(removed==NULL) removed = e; } else if(equal(&e->k,k)) { return e; } } } static inline void name##_grow(name *m) { name##_entry *old = m->entries; unsigned old_size = m->size; m->size = m->size==0?(min_size):((m->used+1)*2>m->size?m->size*2:m->size); m->entries = RvR_malloc(sizeof(*m->entries)*m->size); for(unsigned i = 0;i<m->size;i++) m->entries[i].state = 0; m->used = 0; m->removed = 0; for(unsigned i = 0;i<old_size;i++) { if(old[i].state!=1) continue; *name##_slot(m,&old[i].k,1) = old[i]; m->used++; } if(old!=NULL) RvR_free(old); }
+
+//Sorted array, the first inline_count elements are stored inside the struct itself,
+//afterwards it moves to the heap and doubles once full
+//compare(const type *, const type *) returns <0, 0 or >0, like for qsort()
+//_insert returns the index of the new element, _find the index of an equal one (or -1)
+#define RvR_sorted_type(type,name,inline_count) typedef struct { type *data; type small[inline_count]; unsigned size; unsigned used; }name
+#define RvR_sorted_function_prototype(type,name,prefix) prefix unsigned name##_insert(name *v, type x); prefix int name##_find(const name *v, type x); prefix void name##_remove(name *v, unsigned index); prefix type *name##_get(name *v, unsigned index); prefix unsigned name##_count(const name *v); prefix void name##_clear(name *v); prefix void name##_free(name *v)
+#define RvR_sorted_function(type,name,compare,prefix) static inline unsigned name##_search(const name *v, const type *x); prefix unsigned name##_insert(name *v, type x) { unsigned capacity = v->data!=NULL?v->size:sizeof(v->small)/sizeof(v->small[0]); if(v->used==capacity) { if(v->data==NULL) { v->data = RvR_malloc(sizeof(*v->data)*capacity*2); memcpy(v->data,v->small,sizeof(v->small)); } else { v->data = RvR_realloc(v->data,sizeof(*v->data)*capacity*2); } v->size = capacity*2; } type *d = v->data!=NULL?v->data:v->small; unsigned index = name##_search(v,&x); memmove(d+index+1,d+index,sizeof(*d)*(v->used-index)); d[index] = x; v->used++; return index; } prefix int name##_find(const name *v, type x) { const type *d = v->data!=NULL?v->data:v->small; unsigned index = name##_search(v,&x); if(index<v->used&&compare(&d[index],&x)==0) return (int)index; return -1; } prefix void name##_remove(name *v, unsigned index) { type *d = v->data!=NULL?v->data:v->small; if(index>=v->used) return; v->used--; memmove(d+index,d+index+1,sizeof(*d)*(v->used-index)); } prefix type *name##_get(name *v, unsigned index) { return (v->data!=NULL?v->data:v->small)+index; } prefix unsigned name##_count(const name *v) { return v->used; } prefix void name##_clear(name *v) { v->used = 0; } prefix void name##_free(name *v) { if(v->data!=NULL) RvR_free(v->data); v->data = NULL; v->size = 0; v->used = 0; } static inline unsigned name##_search(const name *v, const type *x) { const type *d = v->data!=NULL?v->data:v->small; unsigned low = 0; unsigned high = v->used; while(low<high) { unsigned mid = low+(high-low)/2; if(compare(&d[mid],x)<0) low = mid+1; else high = mid; } return low; }
 
 //-------------------------------------
 
@@ -73,6 +142,23 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 
 #define RVR_PORT_MAX_SECTORS 4096
 #define RVR_PORT_MAX_WALLS 16384
+
+//Maximum amount of threads (and thus screen column bands)
+//the portal renderer can use, see RvR_port_set_threads()
+#define RVR_PORT_MAX_THREADS 8
+//-------------------------------------
+
+//RvnicRaven pseudo3d
+
+//Length of a track segment
+#define RVR_P3D_SEGMENT_LENGTH 1024
+
+//Amount of segments projected per frame,
+//basically render distance
+#define RVR_P3D_DRAW_DISTANCE 256
+
+//Half of the road's width
+#define RVR_P3D_ROAD_WIDTH 2048
 //-------------------------------------
 
 //Config end
@@ -194,6 +280,56 @@ typedef struct
    }as;
 }RvR_rw;
 
+typedef struct
+{
+   int32_t p50;
+   int32_t p95;
+   int32_t p99;
+   int32_t max;
+}RvR_telemetry_percentiles;
+
+typedef struct
+{
+   uint32_t frames;
+   uint32_t hitches;
+   uint32_t hitches_total; //Since the last reset, not limited to the recorded frames
+   RvR_telemetry_percentiles frametime; //Time spent working, in microseconds
+   RvR_telemetry_percentiles delta; //Time between frames, in microseconds
+}RvR_telemetry_stats;
+
+typedef enum
+{
+   RVR_CAPTURE_PNG,
+   RVR_CAPTURE_VIDEO,
+}RvR_capture_format;
+
+typedef struct
+{
+   size_t used;
+   uint32_t overflow;
+}RvR_frame_marker;
+
+//Zero initialize before use
+typedef struct
+{
+   int value;
+   int parked;
+}RvR_job_counter;
+
+//See RvR_hash_begin()
+typedef struct
+{
+   uint64_t lanes[2];
+   uint64_t length;
+   uint8_t buffer[32];
+   uint32_t buffer_used;
+}RvR_hash_state;
+
+typedef void (*RvR_job_func)(void *data, int start, int end);
+
+//Returns the amount of bytes released, see RvR_malloc_evict_register()
+typedef size_t (*RvR_malloc_evict_func)(size_t size);
+
 //RvnicRaven core types end
 //-------------------------------------
 
@@ -205,7 +341,14 @@ int      RvR_core_running();
 void     RvR_core_update();
 int      RvR_core_frametime();
 int      RvR_core_frametime_average();
+int      RvR_core_ticks();
+RvR_fix22 RvR_core_tick_alpha();
+void     RvR_core_fps(int fps);
+void     RvR_core_frame_pacing(int precise);
 void     RvR_core_render_present();
+void     RvR_core_present_threads(int threads);
+void     RvR_core_present_dirty(int dirty);
+void     RvR_core_present_pipelined(int pipelined);
 uint8_t *RvR_core_framebuffer();
 uint32_t RvR_core_frame();
 
@@ -225,6 +368,24 @@ int  RvR_core_mouse_wheel_scroll();
 void RvR_core_text_input_start(char *text, int max_length);
 void RvR_core_text_input_end();
 
+//Records the input and RvR_core_ticks() of every frame,
+//replays feed both back and quit once the recording ends
+void RvR_core_record_start(const char *path);
+void RvR_core_record_end();
+void RvR_core_replay_start(const char *path);
+void RvR_core_replay_end();
+int  RvR_core_replaying();
+
+//Only available in the null backend (RVR_BACKEND_NULL)
+void RvR_null_script(const char *path);
+void RvR_null_key(RvR_key key, int down);
+void RvR_null_gamepad(int index, RvR_gamepad_button button, int down);
+void RvR_null_mouse(int x, int y);
+void RvR_null_wheel(int scroll);
+void RvR_null_text(const char *text);
+void RvR_null_virtual_time(int virtual_time);
+void RvR_null_dump(const char *path); //printf style path, receives frame number, NULL to disable
+
 RvR_config RvR_ini_parse(RvR_rw *rw);
 void       RvR_ini_free(RvR_config config);
 void       RvR_ini_read(RvR_config config, void *dst, RvR_config_type type, const char *ident);
@@ -272,6 +433,39 @@ void RvR_draw_line(int x0, int y0, int x1, int y1, uint8_t index);
 void RvR_draw_vertical_line(int x, int y0, int y1, uint8_t index);
 void RvR_draw_horizontal_line(int x0, int x1, int y, uint8_t index);
 
+//Frametimes get recorded by RvR_core_update(),
+//a frame counts as a hitch if the time between frames exceeds the threshold
+void RvR_telemetry_record(uint32_t frame, int32_t frametime, int32_t delta);
+void RvR_telemetry_reset();
+void RvR_telemetry_hitch_threshold(int32_t threshold);
+void RvR_telemetry_stats_get(RvR_telemetry_stats *stats);
+void RvR_telemetry_csv(const char *path);
+void RvR_telemetry_csv_at_exit(const char *path);
+
+void RvR_image_write_ppm(RvR_rw *rw, int width, int height, const uint8_t *data, const RvR_color *pal);
+void RvR_image_write_png(RvR_rw *rw, int width, int height, const uint8_t *data, const RvR_color *pal);
+
+//Captures presented frames, written by a background thread
+//RVR_CAPTURE_PNG: path is a format string receiving the frame number (e.g. "frame%05u.png")
+void RvR_capture_start(const char *path, RvR_capture_format format);
+void RvR_capture_stop();
+int RvR_capture_active();
+uint32_t RvR_capture_dropped();
+void RvR_capture_frame();
+
+//Job system, jobs run on the calling thread until
+//RvR_job_init() starts worker threads, RvR_job_quit() joins them
+//Jobs may use RvR_malloc/RvR_free/RvR_realloc and wait on other jobs,
+//but must not use RvR_frame_alloc(), load textures or lumps,
+//or rely on eviction callbacks freeing memory for them (main thread only)
+void RvR_job_init(int workers);
+void RvR_job_quit();
+int  RvR_job_workers();
+void RvR_job_run(RvR_job_func func, void *data, int start, int end, RvR_job_counter *counter, RvR_job_counter *depends);
+void RvR_job_wait(RvR_job_counter *counter);
+int  RvR_job_done(RvR_job_counter *counter);
+void RvR_job_parallel_for(RvR_job_func func, void *data, int count, int grain);
+
 void RvR_log(const char *w, ...);
 
 #define RvR_log_line(w,...) do { char RvR_log_line_tmp[1024]; snprintf(RvR_log_line_tmp,1024,__VA_ARGS__); RvR_log(w " (%s:%u): %s\n",__FILE__,__LINE__,RvR_log_line_tmp); } while(0)
@@ -291,17 +485,57 @@ uint32_t RvR_fnv32a(const char *str);
 uint32_t RvR_fnv32a_str(const char *str, uint32_t hval);
 uint32_t RvR_fnv32a_buf(const void *buf, size_t len, uint32_t hval);
 
+//Faster hash for longer keys, RvR_hash_begin/update/end hash data
+//in pieces and give the same result as RvR_hash() on all of it
+uint64_t RvR_hash(const void *buf, size_t len, uint64_t seed);
+uint64_t RvR_hash_str(const char *str, uint64_t seed);
+uint64_t RvR_hash_u64(uint64_t v);
+void     RvR_hash_begin(RvR_hash_state *s, uint64_t seed);
+void     RvR_hash_update(RvR_hash_state *s, const void *buf, size_t len);
+uint64_t RvR_hash_end(const RvR_hash_state *s);
+
+//Key functions for RvR_map_* (see RvR_map_function), string keys aren't copied
+uint32_t RvR_map_hash_u32(const uint32_t *k);
+int      RvR_map_equal_u32(const uint32_t *a, const uint32_t *b);
+uint32_t RvR_map_hash_u64(const uint64_t *k);
+int      RvR_map_equal_u64(const uint64_t *a, const uint64_t *b);
+uint32_t RvR_map_hash_str(const char * const *k);
+int      RvR_map_equal_str(const char * const *a, const char * const *b);
+
 //RvnicRaven provides a custom memory allocater
 //If RvR_malloc_init doesn't get called, all other
 //functions will instead call their stdlib equivalents (free, malloc, realloc).
 //Even if you don't want to use the custom allocater, it's still
 //advised to use these functions instead of the stdlib variants
+//Once full, the heap grows by regions of at least RVR_MALLOC_GROW bytes,
+//RvR_malloc_trim() gives completely free ones back to the system
 void  RvR_malloc_init(size_t min, size_t max);
 void *RvR_malloc(size_t size);
 void  RvR_free(void *ptr);
 void *RvR_realloc(void *ptr, size_t size);
 void  RvR_malloc_report();
 void *RvR_malloc_base();
+void  RvR_malloc_threads_enable();
+void  RvR_malloc_thread_flush();
+size_t RvR_malloc_trim();
+void  RvR_malloc_evict_register(RvR_malloc_evict_func func, int priority, const char *name);
+void  RvR_malloc_evict_report();
+int   RvR_malloc_fragmentation();
+void  RvR_malloc_profile_frame();
+void  RvR_malloc_profile_report();
+#if RVR_MALLOC_PROFILE
+void *RvR_malloc_at(size_t size, const char *file, int line);
+void *RvR_realloc_at(void *ptr, size_t size, const char *file, int line);
+#define RvR_malloc(size) RvR_malloc_at((size),__FILE__,__LINE__)
+#define RvR_realloc(ptr,size) RvR_realloc_at((ptr),(size),__FILE__,__LINE__)
+#endif
+
+//Scratch memory, released every frame by RvR_core_update()
+void            *RvR_frame_alloc(size_t size);
+void             RvR_frame_reset();
+RvR_frame_marker RvR_frame_mark();
+void             RvR_frame_release(RvR_frame_marker mark);
+size_t           RvR_frame_peak();
 
 //RvnicRaven stores its palette in a binary format, with the
 //colors just being dumped sequentially (768 bytes --> 256 colors --> 1 byte r,g,b each)
@@ -444,6 +678,7 @@ typedef struct
    uint16_t *ceil_tex;
    uint16_t *wall_ftex;
    uint16_t *wall_ctex;
+   uint8_t *shade; //Added to distance shading, 0 fully lit, 63 black
    RvR_ray_map_sprite *sprites;
 }RvR_ray_map;
 
@@ -459,6 +694,7 @@ typedef struct
    uint16_t ceil_tex;
    RvR_fix22 fheight;
    RvR_fix22 cheight;
+   uint8_t shade;
    RvR_fix22 texture_coord;
 }RvR_ray_hit_result;
 
@@ -531,6 +767,7 @@ uint16_t  RvR_ray_map_floor_tex_at(int16_t x, int16_t y);
 uint16_t  RvR_ray_map_ceil_tex_at(int16_t x, int16_t y);
 uint16_t  RvR_ray_map_wall_ftex_at(int16_t x, int16_t y);
 uint16_t  RvR_ray_map_wall_ctex_at(int16_t x, int16_t y);
+uint8_t   RvR_ray_map_shade_at(int16_t x, int16_t y);
 
 RvR_fix22 RvR_ray_map_floor_height_at_us(int16_t x, int16_t y);
 RvR_fix22 RvR_ray_map_ceiling_height_at_us(int16_t x, int16_t y);
@@ -538,6 +775,7 @@ uint16_t  RvR_ray_map_floor_tex_at_us(int16_t x, int16_t y);
 uint16_t  RvR_ray_map_ceil_tex_at_us(int16_t x, int16_t y);
 uint16_t  RvR_ray_map_wall_ftex_at_us(int16_t x, int16_t y);
 uint16_t  RvR_ray_map_wall_ctex_at_us(int16_t x, int16_t y);
+uint8_t   RvR_ray_map_shade_at_us(int16_t x, int16_t y);
 
 void RvR_ray_map_floor_height_set(int16_t x, int16_t y, RvR_fix22 height);
 void RvR_ray_map_ceiling_height_set(int16_t x, int16_t y, RvR_fix22 height);
@@ -545,6 +783,7 @@ void RvR_ray_map_floor_tex_set(int16_t x, int16_t y, uint16_t tex);
 void RvR_ray_map_ceil_tex_set(int16_t x, int16_t y, uint16_t tex);
 void RvR_ray_map_wall_ftex_set(int16_t x, int16_t y, uint16_t tex);
 void RvR_ray_map_wall_ctex_set(int16_t x, int16_t y, uint16_t tex);
+void RvR_ray_map_shade_set(int16_t x, int16_t y, uint8_t shade);
 
 //RvnicRaven raycast functions end
 //-------------------------------------
@@ -560,6 +799,15 @@ typedef struct
    uint16_t tex;
 }RvR_port_wall;
 
+//Derived from the walls by RvR_port_sector_geometry_update(),
+//stored parallel to RvR_port_map.walls
+typedef struct
+{
+   RvR_vec2 dir; //p2-p
+   RvR_fix22 length;
+   RvR_vec2 normal; //Unit length, pointing into the sector
+}RvR_port_wall_geometry;
+
 typedef struct
 {
    int16_t num_walls;
@@ -570,11 +818,28 @@ typedef struct
 
    uint16_t floor_tex;
    uint16_t ceiling_tex;
+
+   uint8_t shade; //Added to distance shading, 0 fully lit, 63 black
+
+   //First sprite in sector, -1 if none
+   int32_t sprite_first;
+
+   //Bounding box of the sector's walls,
+   //updated by RvR_port_sector_geometry_update()
+   RvR_vec2 bb_min;
+   RvR_vec2 bb_max;
 }RvR_port_sector;
 
 typedef struct
 {
+   RvR_vec3 pos;
+   uint16_t tex;
+   uint32_t flags; //Same as RvR_ray_draw_sprite(), only billboards for now
+   int16_t sector;
 
+   //Sector sprite list, only modify through RvR_port_sprite_move()
+   int32_t prev;
+   int32_t next;
 }RvR_port_sprite;
 
 typedef struct
@@ -584,6 +849,11 @@ typedef struct
 
    RvR_port_sector sectors[RVR_PORT_MAX_SECTORS];
    RvR_port_wall walls[RVR_PORT_MAX_WALLS];
+   RvR_port_wall_geometry wall_geometry[RVR_PORT_MAX_WALLS];
+
+   //Set by RvR_port_map_create(), the geometry of all
+   //sectors gets updated before it is used next if set
+   uint8_t geometry_dirty;
 }RvR_port_map;
 
 //RvnicRaven portal types end
@@ -605,6 +875,11 @@ RvR_fix22 RvR_port_perspective_scale_vertical_inverse(RvR_fix22 org_size, RvR_fi
 void      RvR_port_set_fov(RvR_fix22 fov);
 RvR_fix22 RvR_port_get_fov();
 
+//Splits the screen into 'threads' column bands, which get drawn in parallel by the job system
+//(only once RvR_job_init() started workers), 1 (default) draws everything on the calling thread
+void RvR_port_set_threads(int threads);
+int  RvR_port_get_threads();
+
 void RvR_port_map_create();
 void RvR_port_map_load_path();
 void RvR_port_map_load(uint16_t id);
@@ -613,6 +888,19 @@ void RvR_port_map_save(const char *path);
 
 RvR_port_map *RvR_port_map_get();
 
+//Needs to be called after modifying a sector's walls,
+//both sectors need to be updated when editing a portal
+//A freshly created map is updated on first use
+void RvR_port_map_geometry_update();
+void RvR_port_sector_geometry_update(int16_t sector);
+
+//Only sprites in sectors visible from the camera get drawn
+//Pointers returned by RvR_port_sprite_get() stay valid until the sprite gets freed
+int32_t          RvR_port_sprite_new(int16_t sector);
+void             RvR_port_sprite_free(int32_t sprite);
+RvR_port_sprite *RvR_port_sprite_get(int32_t sprite);
+void             RvR_port_sprite_move(int32_t sprite, int16_t sector);
+
 int RvR_port_sector_inside(int16_t sector, RvR_fix22 x, RvR_fix22 y);
 int16_t RvR_port_sector_update(int16_t last_sector, RvR_fix22 x, RvR_fix22 y);
 
@@ -632,7 +920,7 @@ typedef struct
 
 typedef struct
 {
-   RvR_fix22 pos;
+   RvR_fix22 pos; //Offset from road center
    uint16_t tex;
    uint16_t flags;
    int32_t next;
@@ -648,7 +936,8 @@ typedef struct
    uint8_t color_border;
    uint8_t color_road;
    uint8_t color_lane;
-   uint8_t line;
+   uint8_t color_grass;
+   uint8_t line; //Amount of lanes, no lane markings if <2
    int32_t sprite_first;
 }RvR_p3d_segment;
 
@@ -657,9 +946,27 @@ typedef struct
 
 //RvnicRaven pseudo3d functions
 
-int32_t RvR_p3d_sprite_new();
-void    RvR_p3d_sprite_free(int32_t sprite);
-
+void      RvR_p3d_set_position(RvR_vec3 position); //x: offset from road center, y: height, z: distance along track
+RvR_vec3  RvR_p3d_get_position();
+void      RvR_p3d_set_fov(RvR_fix22 fov);
+RvR_fix22 RvR_p3d_get_fov();
+
+//Segment p0/p1.z are set by RvR_p3d_track_create(),
+//indices passed to RvR_p3d_segment_get() wrap around
+void             RvR_p3d_track_create(int32_t segments);
+int32_t          RvR_p3d_track_length();
+RvR_fix22        RvR_p3d_track_height(RvR_fix22 z);
+RvR_p3d_segment *RvR_p3d_segment_get(int32_t segment);
+void             RvR_p3d_segment_sprite_add(int32_t segment, int32_t sprite);
+void             RvR_p3d_segment_sprite_remove(int32_t segment, int32_t sprite);
+
+//Sprites need to be removed from their segment before being freed
+int32_t         RvR_p3d_sprite_new();
+void            RvR_p3d_sprite_free(int32_t sprite);
+RvR_p3d_sprite *RvR_p3d_sprite_get(int32_t sprite);
+
+//The area above the horizon is not drawn,
+//RvR_p3d_draw_track() draws the road, sprites get drawn in RvR_p3d_draw_end()
 void RvR_p3d_draw_begin();
 void RvR_p3d_draw_track();
 void RvR_p3d_draw_end();
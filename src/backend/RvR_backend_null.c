@@ -0,0 +1,665 @@
+/*
+RvnicRaven retro game engine
+
+Written in 2021,2022 by Lukas Holzbeierlein (Captain4LK) email: captain4lk [at] tutanota [dot] com
+
+To the extent possible under law, the author(s) have dedicated all copyright and related and neighboring rights to this software to the public domain worldwide. This software is distributed without any warranty.
+
+You should have received a copy of the CC0 Public Domain Dedication along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+/*
+Headless backend, selected by compiling with RVR_BACKEND_NULL set to 1.
+
+Renders into an in memory framebuffer, input is injected through
+the RvR_null_* functions or a script file. Time is either measured,
+but never throttled, or purely virtual (every frame takes exactly
+1/RVR_FPS seconds).
+
+Script files contain one event per line, in ascending frame order:
+   <frame> key <key> <0/1>
+   <frame> pad <index> <button> <0/1>
+   <frame> mouse <x> <y>
+   <frame> wheel <scroll>
+   <frame> text <text>
+   <frame> quit
+*/
+
+//External includes
+//Needs to come before the first system header, see RvR_all.c
+#if !defined(_WIN32)&&!defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)||(defined(__EMSCRIPTEN__)&&!defined(__EMSCRIPTEN_PTHREADS__))
+#define NULL_THREADS 0
+#else
+#define NULL_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+//-------------------------------------
+
+//Internal includes
+#include "../RvnicRaven.h"
+//-------------------------------------
+
+//#defines
+#define MAX_CONTROLLERS 4
+//-------------------------------------
+
+//Typedefs
+typedef enum
+{
+   NULL_EVENT_KEY,
+   NULL_EVENT_PAD,
+   NULL_EVENT_MOUSE,
+   NULL_EVENT_WHEEL,
+   NULL_EVENT_TEXT,
+   NULL_EVENT_QUIT,
+}Null_event_type;
+
+typedef struct
+{
+   uint32_t frame;
+   Null_event_type type;
+   int a;
+   int b;
+   int c;
+   char *text;
+}Null_event;
+
+typedef struct
+{
+   uint8_t new_button_state[RVR_PAD_MAX];
+   uint8_t old_button_state[RVR_PAD_MAX];
+   uint8_t last_button_state[RVR_PAD_MAX];
+}Gamepad;
+
+#if NULL_THREADS
+typedef struct
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int value;
+}Null_semaphore;
+#endif
+//-------------------------------------
+
+//Variables
+static uint8_t *framebuffer = NULL;
+static uint32_t null_frame = 0;
+
+//Injected input goes to new_key_state directly, the state
+//at the end of the last update is kept in last_key_state,
+//so that input injected between frames counts as pressed
+static uint8_t new_key_state[RVR_KEY_MAX];
+static uint8_t old_key_state[RVR_KEY_MAX];
+static uint8_t last_key_state[RVR_KEY_MAX];
+static Gamepad gamepads[MAX_CONTROLLERS];
+static int mouse_x;
+static int mouse_y;
+static int mouse_x_last;
+static int mouse_y_last;
+static int mouse_x_rel;
+static int mouse_y_rel;
+static int mouse_wheel;
+static int mouse_wheel_next;
+static char *text_input;
+static int text_input_active;
+static unsigned text_input_max;
+
+//Scripted input
+static Null_event *null_events = NULL;
+static int null_event_count = 0;
+static int null_event_next = 0;
+
+//Timing
+static int null_virtual_time = 0;
+static uint64_t framestart;
+static uint64_t frametime;
+static uint64_t framedelta;
+static uint64_t framedelay;
+
+//Frame dumps
+static char *null_dump_path = NULL;
+//-------------------------------------
+
+//Function prototypes
+static uint64_t null_time();
+static void null_events_run();
+static void null_dump();
+//-------------------------------------
+
+//Function implementations
+
+void RvR_backend_init(const char *title, int scale)
+{
+   RvR_log("null backend: '%s' (scale %d ignored)\n",title,scale);
+
+   memset(new_key_state,0,sizeof(new_key_state));
+   memset(old_key_state,0,sizeof(old_key_state));
+   memset(last_key_state,0,sizeof(last_key_state));
+   memset(gamepads,0,sizeof(gamepads));
+
+   framedelay = 1000000/RVR_FPS;
+   framestart = null_time();
+
+   framebuffer = RvR_malloc(RVR_XRES*RVR_YRES);
+   memset(framebuffer,0,RVR_XRES*RVR_YRES);
+}
+
+void RvR_null_script(const char *path)
+{
+   FILE *f = fopen(path,"r");
+   if(f==NULL)
+   {
+      RvR_log_line("RvR_null_script","failed to open '%s'\n",path);
+      return;
+   }
+
+   char line[512];
+   char cmd[32];
+   int line_num = 0;
+   while(fgets(line,512,f))
+   {
+      line_num++;
+      unsigned frame;
+      int pos = 0;
+      if(line[0]=='\n'||line[0]=='#'||sscanf(line,"%u %31s %n",&frame,cmd,&pos)<2)
+         continue;
+
+      Null_event ev = {0};
+      ev.frame = frame;
+      if(strcmp(cmd,"key")==0&&sscanf(line+pos,"%d %d",&ev.a,&ev.b)==2)
+      {
+         ev.type = NULL_EVENT_KEY;
+      }
+      else if(strcmp(cmd,"pad")==0&&sscanf(line+pos,"%d %d %d",&ev.a,&ev.b,&ev.c)==3)
+      {
+         ev.type = NULL_EVENT_PAD;
+      }
+      else if(strcmp(cmd,"mouse")==0&&sscanf(line+pos,"%d %d",&ev.a,&ev.b)==2)
+      {
+         ev.type = NULL_EVENT_MOUSE;
+      }
+      else if(strcmp(cmd,"wheel")==0&&sscanf(line+pos,"%d",&ev.a)==1)
+      {
+         ev.type = NULL_EVENT_WHEEL;
+      }
+      else if(strcmp(cmd,"text")==0)
+      {
+         ev.type = NULL_EVENT_TEXT;
+         line[strcspn(line,"\r\n")] = '\0';
+         ev.text = RvR_malloc(strlen(line+pos)+1);
+         strcpy(ev.text,line+pos);
+      }
+      else if(strcmp(cmd,"quit")==0)
+      {
+         ev.type = NULL_EVENT_QUIT;
+      }
+      else
+      {
+         RvR_log_line("RvR_null_script","%s:%d: invalid event\n",path,line_num);
+         continue;
+      }
+
+      null_events = RvR_realloc(null_events,sizeof(*null_events)*(null_event_count+1));
+      null_events[null_event_count++] = ev;
+   }
+
+   fclose(f);
+}
+
+void RvR_null_key(RvR_key key, int down)
+{
+   if(key>=0&&key<RVR_KEY_MAX)
+      new_key_state[key] = !!down;
+}
+
+void RvR_null_gamepad(int index, RvR_gamepad_button button, int down)
+{
+   if(index>=0&&index<MAX_CONTROLLERS&&button>=0&&button<RVR_PAD_MAX)
+      gamepads[index].new_button_state[button] = !!down;
+}
+
+void RvR_null_mouse(int x, int y)
+{
+   mouse_x = RvR_clamp(x,0,RVR_XRES-1);
+   mouse_y = RvR_clamp(y,0,RVR_YRES-1);
+}
+
+void RvR_null_wheel(int scroll)
+{
+   mouse_wheel_next+=scroll;
+}
+
+void RvR_null_text(const char *text)
+{
+   if(text_input_active&&strlen(text_input)+strlen(text)<text_input_max)
+      strcat(text_input,text);
+}
+
+void RvR_null_virtual_time(int virtual_time)
+{
+   null_virtual_time = virtual_time;
+}
+
+void RvR_null_dump(const char *path)
+{
+   RvR_free(null_dump_path);
+   null_dump_path = NULL;
+   if(path==NULL)
+      return;
+
+   null_dump_path = RvR_malloc(strlen(path)+1);
+   strcpy(null_dump_path,path);
+}
+
+int RvR_backend_frametime()
+{
+   return frametime/100;
+}
+
+int RvR_backend_frame_delta()
+{
+   return framedelta;
+}
+
+void RvR_backend_fps(int fps)
+{
+   framedelay = fps<=0?0:1000000/RvR_min(1000,fps);
+}
+
+void RvR_backend_frame_pacing(int precise)
+{
+   //Frames are never throttled
+   (void)precise;
+}
+
+void RvR_backend_update()
+{
+   //Virtual time: every frame takes exactly the frame delay,
+   //the time spent working is still measured
+   uint64_t now = null_time();
+   frametime = now-framestart;
+   if(null_virtual_time)
+      framedelta = framedelay>0?framedelay:1000000/RVR_FPS;
+   else
+      framedelta = frametime;
+   framestart = now;
+
+   memcpy(old_key_state,last_key_state,sizeof(last_key_state));
+   for(int i = 0;i<MAX_CONTROLLERS;i++)
+      memcpy(gamepads[i].old_button_state,gamepads[i].last_button_state,sizeof(gamepads[0].last_button_state));
+
+   null_events_run();
+   null_frame++;
+
+   memcpy(last_key_state,new_key_state,sizeof(new_key_state));
+   for(int i = 0;i<MAX_CONTROLLERS;i++)
+      memcpy(gamepads[i].last_button_state,gamepads[i].new_button_state,sizeof(gamepads[0].new_button_state));
+
+   mouse_wheel = mouse_wheel_next;
+   mouse_wheel_next = 0;
+   mouse_x_rel = mouse_x-mouse_x_last;
+   mouse_y_rel = mouse_y-mouse_y_last;
+   mouse_x_last = mouse_x;
+   mouse_y_last = mouse_y;
+}
+
+void RvR_backend_render_present()
+{
+   if(null_dump_path!=NULL)
+      null_dump();
+}
+
+void RvR_backend_mouse_relative(int relative)
+{
+   (void)relative;
+}
+
+void RvR_backend_mouse_show(int show)
+{
+   (void)show;
+}
+
+void RvR_backend_present_threads(int threads)
+{
+   (void)threads;
+}
+
+void RvR_backend_present_dirty(int dirty)
+{
+   (void)dirty;
+}
+
+void RvR_backend_present_pipelined(int pipelined)
+{
+   (void)pipelined;
+}
+
+int RvR_backend_key_down(int key)
+{
+   return new_key_state[key];
+}
+
+int RvR_backend_key_pressed(int key)
+{
+   return new_key_state[key]&&!old_key_state[key];
+}
+
+int RvR_backend_key_released(int key)
+{
+   return !new_key_state[key]&&old_key_state[key];
+}
+
+int RvR_backend_mouse_wheel_get_scroll()
+{
+   return mouse_wheel;
+}
+
+int RvR_backend_gamepad_down(int index, int key)
+{
+   return gamepads[index].new_button_state[key];
+}
+
+int RvR_backend_gamepad_pressed(int index, int key)
+{
+   return gamepads[index].new_button_state[key]&&!gamepads[index].old_button_state[key];
+}
+
+int RvR_backend_gamepad_released(int index, int key)
+{
+   return !gamepads[index].new_button_state[key]&&gamepads[index].old_button_state[key];
+}
+
+void RvR_backend_mouse_get_relative_pos(int *x, int *y)
+{
+   *x = mouse_x_rel;
+   *y = mouse_y_rel;
+}
+
+void RvR_backend_mouse_get_pos(int *x, int *y)
+{
+   *x = mouse_x;
+   *y = mouse_y;
+}
+
+void RvR_backend_mouse_set_pos(int x, int y)
+{
+   RvR_null_mouse(x,y);
+   mouse_x_last = mouse_x;
+   mouse_y_last = mouse_y;
+}
+
+void RvR_backend_text_input_start(char *text, int max_length)
+{
+   text_input = text;
+   text_input_active = 1;
+   text_input_max = max_length;
+}
+
+void RvR_backend_text_input_end()
+{
+   text_input_active = 0;
+}
+
+uint8_t *RvR_backend_framebuffer()
+{
+   return framebuffer;
+}
+
+void RvR_backend_key_repeat(int repeat)
+{
+   (void)repeat;
+}
+
+//Monotonic time in microseconds
+static uint64_t null_time()
+{
+#if NULL_THREADS&&defined(_POSIX_TIMERS)&&_POSIX_TIMERS>0
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return (uint64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+#else
+   return ((uint64_t)clock()*1000000)/CLOCKS_PER_SEC;
+#endif
+}
+
+static void null_events_run()
+{
+   while(null_event_next<null_event_count&&null_events[null_event_next].frame<=null_frame)
+   {
+      Null_event *ev = &null_events[null_event_next++];
+      switch(ev->type)
+      {
+      case NULL_EVENT_KEY: RvR_null_key(ev->a,ev->b); break;
+      case NULL_EVENT_PAD: RvR_null_gamepad(ev->a,ev->b,ev->c); break;
+      case NULL_EVENT_MOUSE: RvR_null_mouse(ev->a,ev->b); break;
+      case NULL_EVENT_WHEEL: RvR_null_wheel(ev->a); break;
+      case NULL_EVENT_TEXT: RvR_null_text(ev->text); break;
+      case NULL_EVENT_QUIT: RvR_core_quit(); break;
+      }
+   }
+}
+
+//Dump path is a format string receiving the frame number,
+//the file extension selects between ppm and png
+static void null_dump()
+{
+   if(RvR_palette()==NULL)
+      return;
+
+   char path[512];
+   snprintf(path,512,null_dump_path,RvR_core_frame());
+   const char *ext = strrchr(path,'.');
+
+   RvR_rw rw;
+   RvR_rw_init_path(&rw,path,"wb");
+   if(!RvR_rw_valid(&rw))
+      return;
+
+   if(ext!=NULL&&strcmp(ext,".ppm")==0)
+      RvR_image_write_ppm(&rw,RVR_XRES,RVR_YRES,framebuffer,RvR_palette());
+   else
+      RvR_image_write_png(&rw,RVR_XRES,RVR_YRES,framebuffer,RvR_palette());
+
+   RvR_rw_close(&rw);
+}
+
+#if NULL_THREADS
+
+typedef struct
+{
+   pthread_t thread;
+   int (*func)(void *data);
+   void *data;
+}Null_thread;
+
+static void *null_thread_start(void *data)
+{
+   Null_thread *thread = data;
+   thread->func(thread->data);
+
+   return NULL;
+}
+
+void *RvR_backend_thread_create(int (*func)(void *data), void *data)
+{
+   RvR_malloc_threads_enable();
+
+   Null_thread *thread = RvR_malloc(sizeof(*thread));
+   thread->func = func;
+   thread->data = data;
+   if(pthread_create(&thread->thread,NULL,null_thread_start,thread)!=0)
+   {
+      RvR_log_line("pthread_create ","failed to create thread\n");
+      RvR_free(thread);
+      return NULL;
+   }
+
+   return thread;
+}
+
+void RvR_backend_thread_wait(void *thread)
+{
+   if(thread==NULL)
+      return;
+
+   Null_thread *t = thread;
+   pthread_join(t->thread,NULL);
+   RvR_free(t);
+}
+
+int RvR_backend_cpu_count()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+   return RvR_max(1,sysconf(_SC_NPROCESSORS_ONLN));
+#else
+   return 1;
+#endif
+}
+
+void *RvR_backend_mutex_create()
+{
+   pthread_mutex_t *mutex = RvR_malloc(sizeof(*mutex));
+   pthread_mutex_init(mutex,NULL);
+
+   return mutex;
+}
+
+void RvR_backend_mutex_lock(void *mutex)
+{
+   pthread_mutex_lock(mutex);
+}
+
+void RvR_backend_mutex_unlock(void *mutex)
+{
+   pthread_mutex_unlock(mutex);
+}
+
+void RvR_backend_mutex_destroy(void *mutex)
+{
+   if(mutex==NULL)
+      return;
+
+   pthread_mutex_destroy(mutex);
+   RvR_free(mutex);
+}
+
+void *RvR_backend_semaphore_create(int value)
+{
+   Null_semaphore *sem = RvR_malloc(sizeof(*sem));
+   pthread_mutex_init(&sem->mutex,NULL);
+   pthread_cond_init(&sem->cond,NULL);
+   sem->value = value;
+
+   return sem;
+}
+
+void RvR_backend_semaphore_wait(void *sem)
+{
+   Null_semaphore *s = sem;
+   pthread_mutex_lock(&s->mutex);
+   while(s->value==0)
+      pthread_cond_wait(&s->cond,&s->mutex);
+   s->value--;
+   pthread_mutex_unlock(&s->mutex);
+}
+
+void RvR_backend_semaphore_post(void *sem)
+{
+   Null_semaphore *s = sem;
+   pthread_mutex_lock(&s->mutex);
+   s->value++;
+   pthread_cond_signal(&s->cond);
+   pthread_mutex_unlock(&s->mutex);
+}
+
+void RvR_backend_semaphore_destroy(void *sem)
+{
+   if(sem==NULL)
+      return;
+
+   Null_semaphore *s = sem;
+   pthread_cond_destroy(&s->cond);
+   pthread_mutex_destroy(&s->mutex);
+   RvR_free(s);
+}
+
+#else
+
+//No threads, callers fall back to doing the work themselves.
+//Mutexes and semaphores are still handed out, so that code
+//creating them before any thread doesn't need special cases
+static int null_sync_dummy;
+
+void *RvR_backend_thread_create(int (*func)(void *data), void *data)
+{
+   (void)func;
+   (void)data;
+
+   return NULL;
+}
+
+void RvR_backend_thread_wait(void *thread)
+{
+   (void)thread;
+}
+
+int RvR_backend_cpu_count()
+{
+   return 1;
+}
+
+void *RvR_backend_mutex_create()
+{
+   return &null_sync_dummy;
+}
+
+void RvR_backend_mutex_lock(void *mutex)
+{
+   (void)mutex;
+}
+
+void RvR_backend_mutex_unlock(void *mutex)
+{
+   (void)mutex;
+}
+
+void RvR_backend_mutex_destroy(void *mutex)
+{
+   (void)mutex;
+}
+
+void *RvR_backend_semaphore_create(int value)
+{
+   (void)value;
+
+   return &null_sync_dummy;
+}
+
+void RvR_backend_semaphore_wait(void *sem)
+{
+   (void)sem;
+}
+
+void RvR_backend_semaphore_post(void *sem)
+{
+   (void)sem;
+}
+
+void RvR_backend_semaphore_destroy(void *sem)
+{
+   (void)sem;
+}
+
+#endif
+//-------------------------------------
@@ -12,6 +12,13 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <string.h>
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#include <immintrin.h>
+#define PRESENT_AVX2 1
+#else
+#define PRESENT_AVX2 0
+#endif
 //-------------------------------------
 
 //Internal includes
@@ -20,6 +27,9 @@ You should have received a copy of the CC0 Public Domain Dedication along with t
 
 //#defines
 #define MAX_CONTROLLERS 4
+#define PRESENT_MAX_THREADS 8
+#define PRESENT_BLOCK_WIDTH 32
+#define PRESENT_BLOCK_HEIGHT 16
 //-------------------------------------
 
 //Typedefs
@@ -32,6 +42,14 @@ typedef struct
    uint8_t new_button_state[RVR_PAD_MAX];
    uint8_t old_button_state[RVR_PAD_MAX];
 }Gamepad;
+
+typedef struct
+{
+   int y0;
+   int y1;
+   void *thread;
+   void *start;
+}Present_worker;
 //-------------------------------------
 
 //Variables
@@ -66,13 +84,79 @@ static int key_repeat = 0;
 static uint64_t frametime;
 static uint64_t framedelay;
 static uint64_t framestart;
-
-static uint8_t *framebuffer = NULL;
+static uint64_t framedelta;
+static int pacing_precise = 0;
+
+static uint8_t *framebuffer = NULL; //Buffer the game draws to
+static uint8_t *framebuffers[2] = {NULL,NULL};
+
+//Palette expansion
+static RvR_color present_pal[256];
+static uint32_t present_pal32[256];
+static int present_pal_valid = 0;
+static uint64_t *present_pal_pairs = NULL; //Two colors for every pair of indices
+static int present_avx2 = 0;
+static int present_threads = 1;
+static Present_worker present_workers[PRESENT_MAX_THREADS];
+static void *present_done = NULL;
+static const uint8_t *present_src = NULL;
+static uint8_t *present_dst = NULL; //Origin of the destination is (present_x,present_y)
+static int present_stride = 0;
+static int present_x = 0;
+static int present_y = 0;
+
+//Dirty rectangles
+static int present_dirty = 0;
+static int present_dirty_valid = 0;
+static uint8_t *present_last = NULL;
+static uint8_t *present_rect = NULL;
+
+//Pipelined present
+static int present_pipelined = 0;
+static int present_inflight = 0;
+static uint8_t *present_staging = NULL;
+static void *present_pipeline_thread = NULL;
+static void *present_pipeline_start = NULL;
+static void *present_pipeline_done = NULL;
+
+//Window surface presentation, used instead of a software renderer
+static int present_surface = 0;
+static int present_surface_w = 0;
+static int present_surface_h = 0;
+static SDL_PixelFormat *present_surface_format = NULL;
+static uint32_t present_pal_surface[256];
+static uint64_t present_pal_surface2[256]; //Every color twice, for horizontal scaling
+static int present_scale = 1;
+static int present_scale_width = RVR_XRES;
+static int present_scale_height = RVR_YRES;
 //-------------------------------------
 
 //Function prototypes
 static void backend_update_viewport();
 static int get_gamepad_index(int which);
+static void backend_wait_precise(uint64_t deadline);
+
+static int present_palette_update();
+static void present_full();
+static void present_pipeline();
+static void present_pipeline_finish();
+static int present_pipeline_worker(void *data);
+static void present_expand_threaded();
+static void present_rows(int y0, int y1);
+static void present_to_surface();
+static void present_surface_palette(SDL_PixelFormat *format);
+static void present_expand_scaled(int y0, int y1);
+#if PRESENT_AVX2
+static void present_expand_scaled2_avx2(uint32_t *dst, const uint8_t *src, int width);
+#endif
+static void present_damaged();
+static void present_update_rect(int x, int y, int width, int height);
+static void present_expand(int x0, int x1, int y0, int y1);
+static void present_expand_pairs(int x0, int x1, int y0, int y1);
+#if PRESENT_AVX2
+static void present_expand_avx2(int x0, int x1, int y0, int y1);
+#endif
+static int present_worker(void *data);
 //-------------------------------------
 
 //Function implementations
@@ -124,20 +208,46 @@ void RvR_backend_init(const char *title, int scale)
 
    renderer = SDL_CreateRenderer(sdl_window, -1, SDL_RENDERER_ACCELERATED);
    if(renderer==NULL)
-   {
       RvR_log_line("SDL_CreateRenderer ","%s\n",SDL_GetError());
-      exit(-1);
+
+   //Software renderers scale the whole texture with a generic blit,
+   //without a gpu the frame gets scaled and expanded straight
+   //into the window surface instead
+   SDL_RendererInfo renderer_info;
+   if(renderer!=NULL&&SDL_GetRendererInfo(renderer,&renderer_info)==0&&(renderer_info.flags&SDL_RENDERER_SOFTWARE))
+   {
+      SDL_DestroyRenderer(renderer);
+      renderer = NULL;
    }
 
-   if(SDL_SetRenderDrawColor(renderer,0,0,0,0)!=0)
-      RvR_log_line("SDL_SetRenderDrawColor ","%s\n",SDL_GetError());
+   if(renderer==NULL)
+   {
+      SDL_Surface *surface = SDL_GetWindowSurface(sdl_window);
+      if(surface==NULL)
+      {
+         RvR_log_line("SDL_GetWindowSurface ","%s\n",SDL_GetError());
+         exit(-1);
+      }
+      if(surface->format->BytesPerPixel!=4)
+      {
+         RvR_log_line("SDL_GetWindowSurface ","unsupported window surface format (%d bytes per pixel)\n",surface->format->BytesPerPixel);
+         exit(-1);
+      }
+
+      present_surface = 1;
+   }
+   else
+   {
+      if(SDL_SetRenderDrawColor(renderer,0,0,0,0)!=0)
+         RvR_log_line("SDL_SetRenderDrawColor ","%s\n",SDL_GetError());
 
-   layer_texture = SDL_CreateTexture(renderer,SDL_PIXELFORMAT_RGBA32,SDL_TEXTUREACCESS_STREAMING,RVR_XRES,RVR_YRES);
-   if(layer_texture==NULL)
-      RvR_log_line("SDL_CreateTexture ","%s\n",SDL_GetError());
+      layer_texture = SDL_CreateTexture(renderer,SDL_PIXELFORMAT_RGBA32,SDL_TEXTUREACCESS_STREAMING,RVR_XRES,RVR_YRES);
+      if(layer_texture==NULL)
+         RvR_log_line("SDL_CreateTexture ","%s\n",SDL_GetError());
 
-   if(SDL_SetTextureBlendMode(layer_texture,SDL_BLENDMODE_BLEND)<0)
-      RvR_log_line("SDL_SetTextureBlendMode ","%s\n",SDL_GetError());
+      if(SDL_SetTextureBlendMode(layer_texture,SDL_BLENDMODE_BLEND)<0)
+         RvR_log_line("SDL_SetTextureBlendMode ","%s\n",SDL_GetError());
+   }
 
    backend_update_viewport();
 
@@ -271,8 +381,17 @@ void RvR_backend_init(const char *title, int scale)
    int fps = RvR_max(1,RvR_min(1000,RVR_FPS));
    framedelay = SDL_GetPerformanceFrequency()/fps;
 
-   framebuffer = RvR_malloc(RVR_XRES*RVR_YRES);
-   memset(framebuffer,0,RVR_XRES*RVR_YRES);
+   framebuffers[0] = RvR_malloc(RVR_XRES*RVR_YRES);
+   memset(framebuffers[0],0,RVR_XRES*RVR_YRES);
+   framebuffer = framebuffers[0];
+
+   //Pick palette expansion path
+#if PRESENT_AVX2
+   present_avx2 = SDL_HasAVX2();
+#endif
+   if(!present_avx2)
+      present_pal_pairs = RvR_malloc(sizeof(*present_pal_pairs)*65536);
+   present_palette_update();
 }
 
 int RvR_backend_frametime()
@@ -280,20 +399,49 @@ int RvR_backend_frametime()
    return (frametime*10000)/SDL_GetPerformanceFrequency();
 }
 
+int RvR_backend_frame_delta()
+{
+   return (framedelta*1000000)/SDL_GetPerformanceFrequency();
+}
+
+void RvR_backend_fps(int fps)
+{
+   if(fps<=0)
+      framedelay = 0;
+   else
+      framedelay = SDL_GetPerformanceFrequency()/RvR_min(1000,fps);
+}
+
+void RvR_backend_frame_pacing(int precise)
+{
+   pacing_precise = precise;
+}
+
 void RvR_backend_update()
 {
-#ifndef __EMSCRIPTEN__
    frametime = SDL_GetPerformanceCounter()-framestart;
 
+#ifndef __EMSCRIPTEN__
    if(framedelay>frametime)
    {
-      SDL_Delay(((framedelay-frametime)*1000)/SDL_GetPerformanceFrequency());
+      if(pacing_precise)
+         backend_wait_precise(framestart+framedelay);
+      else
+         SDL_Delay(((framedelay-frametime)*1000)/SDL_GetPerformanceFrequency());
    }
+#endif
 
-   delta = (float)(SDL_GetPerformanceCounter()-framestart)/(float)SDL_GetPerformanceFrequency();
-   framestart = SDL_GetPerformanceCounter();
+   uint64_t now = SDL_GetPerformanceCounter();
+   framedelta = now-framestart;
+   delta = (float)framedelta/(float)SDL_GetPerformanceFrequency();
 
-#endif
+   //Precise pacing schedules frames relative to the last deadline,
+   //so that oversleeping on one frame doesn't accumulate.
+   //After falling more than a frame behind, resync to the current time
+   if(pacing_precise&&framedelay>0&&now-(framestart+framedelay)<framedelay)
+      framestart+=framedelay;
+   else
+      framestart = now;
 
    mouse_wheel = 0;
    memcpy(old_key_state,new_key_state,sizeof(new_key_state));
@@ -406,6 +554,12 @@ void RvR_backend_update()
 
 void RvR_backend_render_present()
 {
+   if(present_surface)
+   {
+      present_to_surface();
+      return;
+   }
+
    if(SDL_RenderClear(renderer)!=0)
       RvR_log_line("SDL_RenderClear ","%s\n",SDL_GetError());
 
@@ -419,18 +573,22 @@ void RvR_backend_render_present()
    dst_rect.w = width;
    dst_rect.h = height;
 
-   void *data;
-   int stride;
-
-   if(SDL_LockTexture(layer_texture,NULL,&data,&stride)!=0)
-      RvR_log_line("SDL_LockTexture ","%s\n",SDL_GetError());
-
-   RvR_color * restrict pix = data;
-   const RvR_color * restrict pal = RvR_palette();
-   for(int i = 0;i<RVR_XRES*RVR_YRES;i++)
-      pix[i] = pal[framebuffer[i]];
+   if(present_pipelined)
+   {
+      present_pipeline();
+   }
+   else
+   {
+      //A changed palette invalidates every pixel
+      present_src = framebuffer;
+      if(present_palette_update())
+         present_dirty_valid = 0;
 
-   SDL_UnlockTexture(layer_texture);
+      if(present_dirty&&present_dirty_valid)
+         present_damaged();
+      else
+         present_full();
+   }
 
    if(SDL_RenderCopy(renderer,layer_texture,NULL,&dst_rect)!=0)
       RvR_log_line("SDL_RenderCopy ","%s\n",SDL_GetError());
@@ -450,10 +608,42 @@ void RvR_backend_mouse_show(int show)
       RvR_log_line("SDL_ShowCursor ","%s\n",SDL_GetError());
 }
 
+//Sleeps until shortly before the deadline, then spins for the rest,
+//since SDL_Delay() may oversleep by up to a scheduler quantum
+static void backend_wait_precise(uint64_t deadline)
+{
+   uint64_t freq = SDL_GetPerformanceFrequency();
+   uint64_t margin = freq/500;
+
+   for(;;)
+   {
+      uint64_t now = SDL_GetPerformanceCounter();
+      if(now>=deadline)
+         break;
+
+      if(deadline-now>margin)
+         SDL_Delay(((deadline-now-margin)*1000)/freq);
+   }
+}
+
 static void backend_update_viewport()
 {
    SDL_GetWindowSize(sdl_window,&window_width,&window_height);
 
+   //Window surface only supports integer scales, windows
+   //smaller than the framebuffer show its top left part
+   if(present_surface)
+   {
+      int scale = RvR_max(1,RvR_min(window_width/RVR_XRES,window_height/RVR_YRES));
+      view_width = RVR_XRES*scale;
+      view_height = RVR_YRES*scale;
+      view_x = RvR_max(0,(window_width-view_width)/2);
+      view_y = RvR_max(0,(window_height-view_height)/2);
+      pixel_scale = scale;
+
+      return;
+   }
+
    float ratio = (float)window_width/(float)window_height;
    //float width_adjust = ((float)RVR_XRES/(float)RVR_YRES)*(float)window_width;
    //float height_adjust = ((float)RVR_XRES/(float)RVR_YRES)*(float)window_height;
@@ -475,6 +665,495 @@ static void backend_update_viewport()
    pixel_scale = (float)view_width/(float)RVR_XRES;
 }
 
+void RvR_backend_present_dirty(int dirty)
+{
+   present_dirty = dirty;
+   present_dirty_valid = 0;
+
+   if(present_dirty&&present_last==NULL)
+   {
+      present_last = RvR_malloc(RVR_XRES*RVR_YRES);
+      present_rect = RvR_malloc(RVR_XRES*RVR_YRES*4);
+   }
+}
+
+static void present_full()
+{
+   void *data;
+   int stride;
+
+   if(SDL_LockTexture(layer_texture,NULL,&data,&stride)!=0)
+   {
+      RvR_log_line("SDL_LockTexture ","%s\n",SDL_GetError());
+      return;
+   }
+
+   present_dst = data;
+   present_stride = stride;
+   present_expand_threaded();
+
+   SDL_UnlockTexture(layer_texture);
+
+   if(present_dirty)
+   {
+      memcpy(present_last,framebuffer,RVR_XRES*RVR_YRES);
+      present_dirty_valid = 1;
+   }
+}
+
+//Compares the framebuffer to the last presented frame in blocks,
+//only uploading rectangles that contain changed blocks.
+//Each row of blocks produces at most one rectangle, which gets merged
+//with the one above if both span the same columns
+static void present_damaged()
+{
+   int rect_x0 = 0;
+   int rect_x1 = 0;
+   int rect_y = 0;
+   int rect_height = 0;
+
+   for(int by = 0;by<RVR_YRES;by+=PRESENT_BLOCK_HEIGHT)
+   {
+      int height = RvR_min(PRESENT_BLOCK_HEIGHT,RVR_YRES-by);
+      int x0 = RVR_XRES;
+      int x1 = 0;
+
+      for(int bx = 0;bx<RVR_XRES;bx+=PRESENT_BLOCK_WIDTH)
+      {
+         int width = RvR_min(PRESENT_BLOCK_WIDTH,RVR_XRES-bx);
+         for(int y = by;y<by+height;y++)
+         {
+            if(memcmp(&framebuffer[y*RVR_XRES+bx],&present_last[y*RVR_XRES+bx],width)!=0)
+            {
+               x0 = RvR_min(x0,bx);
+               x1 = bx+width;
+               break;
+            }
+         }
+      }
+
+      if(rect_height>0&&(x0!=rect_x0||x1!=rect_x1))
+      {
+         present_update_rect(rect_x0,rect_y,rect_x1-rect_x0,rect_height);
+         rect_height = 0;
+      }
+
+      if(x0<x1)
+      {
+         if(rect_height==0)
+         {
+            rect_x0 = x0;
+            rect_x1 = x1;
+            rect_y = by;
+         }
+         rect_height+=height;
+      }
+   }
+
+   if(rect_height>0)
+      present_update_rect(rect_x0,rect_y,rect_x1-rect_x0,rect_height);
+}
+
+void RvR_backend_present_pipelined(int pipelined)
+{
+   if(!pipelined)
+   {
+      present_pipeline_finish();
+      present_pipelined = 0;
+      present_dirty_valid = 0;
+      return;
+   }
+
+   if(present_pipeline_thread==NULL)
+   {
+      if(framebuffers[1]==NULL)
+         framebuffers[1] = RvR_malloc(RVR_XRES*RVR_YRES);
+      if(present_staging==NULL)
+         present_staging = RvR_malloc(RVR_XRES*RVR_YRES*4);
+      RvR_error_check(framebuffers[1]!=NULL,"RvR_backend_present_pipelined","failed to allocate second framebuffer\n");
+      RvR_error_check(present_staging!=NULL,"RvR_backend_present_pipelined","failed to allocate staging buffer\n");
+
+      if(present_pipeline_start==NULL)
+         present_pipeline_start = RvR_backend_semaphore_create(0);
+      if(present_pipeline_done==NULL)
+         present_pipeline_done = RvR_backend_semaphore_create(0);
+      if(present_pipeline_start!=NULL&&present_pipeline_done!=NULL)
+         present_pipeline_thread = RvR_backend_thread_create(present_pipeline_worker,NULL);
+
+      //No threads available, keep presenting synchronously
+      if(present_pipeline_thread==NULL)
+         return;
+   }
+
+   present_pipelined = 1;
+
+RvR_err:
+   return;
+}
+
+//Uploads the frame converted during the last call, then hands
+//the frame that was just drawn to the present thread.
+//The game continues drawing into the other buffer, which starts out
+//as a copy of the frame being presented, since a lot of code
+//relies on the framebuffer keeping its contents.
+//Since SDL only allows rendering on the main thread, only the palette
+//expansion runs on the present thread; this delays presentation by one frame
+static void present_pipeline()
+{
+   present_pipeline_finish();
+
+   present_palette_update();
+   present_src = framebuffer;
+   framebuffer = framebuffer==framebuffers[0]?framebuffers[1]:framebuffers[0];
+   memcpy(framebuffer,present_src,RVR_XRES*RVR_YRES);
+
+   present_inflight = 1;
+   RvR_backend_semaphore_post(present_pipeline_start);
+}
+
+static void present_pipeline_finish()
+{
+   if(!present_inflight)
+      return;
+
+   RvR_backend_semaphore_wait(present_pipeline_done);
+   present_inflight = 0;
+
+   if(SDL_UpdateTexture(layer_texture,NULL,present_staging,RVR_XRES*4)!=0)
+      RvR_log_line("SDL_UpdateTexture ","%s\n",SDL_GetError());
+}
+
+static int present_pipeline_worker(void *data)
+{
+   (void)data;
+
+   for(;;)
+   {
+      RvR_backend_semaphore_wait(present_pipeline_start);
+
+      present_dst = present_staging;
+      present_stride = RVR_XRES*4;
+      present_expand_threaded();
+
+      RvR_backend_semaphore_post(present_pipeline_done);
+   }
+
+   return 0;
+}
+
+//Converts the whole frame to present_dst, rows are split
+//evenly between the calling thread and the workers
+static void present_expand_threaded()
+{
+   present_x = 0;
+   present_y = 0;
+   int threads = 1;
+   for(int i = 1;i<present_threads;i++)
+   {
+      if(present_workers[i].thread==NULL)
+         break;
+      threads++;
+   }
+   for(int i = 1;i<threads;i++)
+   {
+      present_workers[i].y0 = (i*RVR_YRES)/threads;
+      present_workers[i].y1 = ((i+1)*RVR_YRES)/threads;
+      RvR_backend_semaphore_post(present_workers[i].start);
+   }
+   present_rows(0,RVR_YRES/threads);
+   for(int i = 1;i<threads;i++)
+      RvR_backend_semaphore_wait(present_done);
+}
+
+static void present_rows(int y0, int y1)
+{
+   if(present_surface)
+      present_expand_scaled(y0,y1);
+   else
+      present_expand(0,RVR_XRES,y0,y1);
+}
+
+static void present_to_surface()
+{
+   SDL_Surface *surface = SDL_GetWindowSurface(sdl_window);
+   if(surface==NULL)
+   {
+      RvR_log_line("SDL_GetWindowSurface ","%s\n",SDL_GetError());
+      return;
+   }
+
+   if(SDL_MUSTLOCK(surface)&&SDL_LockSurface(surface)!=0)
+   {
+      RvR_log_line("SDL_LockSurface ","%s\n",SDL_GetError());
+      return;
+   }
+
+   //Borders only need to be cleared if the window size changed
+   if(surface->w!=present_surface_w||surface->h!=present_surface_h)
+   {
+      if(SDL_FillRect(surface,NULL,0)!=0)
+         RvR_log_line("SDL_FillRect ","%s\n",SDL_GetError());
+      present_surface_w = surface->w;
+      present_surface_h = surface->h;
+   }
+
+   present_src = framebuffer;
+   if(present_palette_update()||surface->format!=present_surface_format)
+      present_surface_palette(surface->format);
+
+   present_scale = (int)pixel_scale;
+   present_scale_width = RvR_min(RVR_XRES,(surface->w-view_x)/present_scale);
+   present_scale_height = RvR_min(RVR_YRES,(surface->h-view_y)/present_scale);
+   present_dst = (uint8_t *)surface->pixels+view_y*surface->pitch+view_x*4;
+   present_stride = surface->pitch;
+   present_expand_threaded();
+
+   if(SDL_MUSTLOCK(surface))
+      SDL_UnlockSurface(surface);
+
+   if(SDL_UpdateWindowSurface(sdl_window)!=0)
+      RvR_log_line("SDL_UpdateWindowSurface ","%s\n",SDL_GetError());
+}
+
+static void present_surface_palette(SDL_PixelFormat *format)
+{
+   present_surface_format = format;
+
+   for(int i = 0;i<256;i++)
+   {
+      present_pal_surface[i] = SDL_MapRGB(format,present_pal[i].r,present_pal[i].g,present_pal[i].b);
+      uint32_t pair[2] = {present_pal_surface[i],present_pal_surface[i]};
+      memcpy(&present_pal_surface2[i],pair,sizeof(pair));
+   }
+}
+
+//Expands and scales source rows, every source row gets
+//expanded once, the other rows of the scaled pixel are copies
+static void present_expand_scaled(int y0, int y1)
+{
+   int scale = present_scale;
+   int width = present_scale_width;
+   y1 = RvR_min(y1,present_scale_height);
+
+   for(int y = y0;y<y1;y++)
+   {
+      const uint8_t * restrict src = &present_src[y*RVR_XRES];
+      uint8_t *row = &present_dst[y*scale*present_stride];
+      uint32_t * restrict dst = (uint32_t *)row;
+
+      switch(scale)
+      {
+      case 1:
+         for(int x = 0;x<width;x++)
+            dst[x] = present_pal_surface[src[x]];
+         break;
+      case 2:
+#if PRESENT_AVX2
+         if(present_avx2)
+         {
+            present_expand_scaled2_avx2(dst,src,width);
+            break;
+         }
+#endif
+         for(int x = 0;x<width;x++)
+            memcpy(&dst[x*2],&present_pal_surface2[src[x]],8);
+         break;
+      case 3:
+         for(int x = 0;x<width;x++)
+         {
+            uint32_t c = present_pal_surface[src[x]];
+            dst[x*3] = c;
+            dst[x*3+1] = c;
+            dst[x*3+2] = c;
+         }
+         break;
+      case 4:
+         for(int x = 0;x<width;x++)
+         {
+            memcpy(&dst[x*4],&present_pal_surface2[src[x]],8);
+            memcpy(&dst[x*4+2],&present_pal_surface2[src[x]],8);
+         }
+         break;
+      default:
+         for(int x = 0;x<width;x++)
+         {
+            uint32_t c = present_pal_surface[src[x]];
+            for(int i = 0;i<scale;i++)
+               dst[x*scale+i] = c;
+         }
+         break;
+      }
+
+      for(int i = 1;i<scale;i++)
+         memcpy(row+i*present_stride,row,width*scale*4);
+   }
+}
+
+#if PRESENT_AVX2
+//Gathers eight colors and interleaves them with themselves,
+//unpack works per 128 bit lane, so the halves need to be swapped back
+__attribute__((target("avx2"))) static void present_expand_scaled2_avx2(uint32_t *dst, const uint8_t *src, int width)
+{
+   int x = 0;
+   for(;x<width-7;x+=8)
+   {
+      __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[x]));
+      __m256i color = _mm256_i32gather_epi32((const int *)present_pal_surface,index,4);
+      __m256i lo = _mm256_unpacklo_epi32(color,color);
+      __m256i hi = _mm256_unpackhi_epi32(color,color);
+      _mm256_storeu_si256((__m256i *)&dst[x*2],_mm256_permute2x128_si256(lo,hi,0x20));
+      _mm256_storeu_si256((__m256i *)&dst[x*2+8],_mm256_permute2x128_si256(lo,hi,0x31));
+   }
+   for(;x<width;x++)
+      memcpy(&dst[x*2],&present_pal_surface2[src[x]],8);
+}
+#endif
+
+static void present_update_rect(int x, int y, int width, int height)
+{
+   present_dst = present_rect;
+   present_stride = width*4;
+   present_x = x;
+   present_y = y;
+   present_expand(x,x+width,y,y+height);
+
+   SDL_Rect rect;
+   rect.x = x;
+   rect.y = y;
+   rect.w = width;
+   rect.h = height;
+   if(SDL_UpdateTexture(layer_texture,&rect,present_rect,width*4)!=0)
+      RvR_log_line("SDL_UpdateTexture ","%s\n",SDL_GetError());
+
+   for(int i = y;i<y+height;i++)
+      memcpy(&present_last[i*RVR_XRES+x],&framebuffer[i*RVR_XRES+x],width);
+}
+
+void RvR_backend_present_threads(int threads)
+{
+   threads = RvR_max(1,RvR_min(PRESENT_MAX_THREADS,threads));
+
+   if(threads>1&&present_done==NULL)
+      present_done = RvR_backend_semaphore_create(0);
+   if(present_done==NULL)
+      return;
+
+   //Workers are never destroyed, lowering the thread
+   //count only leaves them idle
+   for(int i = 1;i<threads;i++)
+   {
+      if(present_workers[i].thread!=NULL)
+         continue;
+
+      present_workers[i].start = RvR_backend_semaphore_create(0);
+      if(present_workers[i].start!=NULL)
+         present_workers[i].thread = RvR_backend_thread_create(present_worker,&present_workers[i]);
+      if(present_workers[i].thread==NULL)
+      {
+         RvR_backend_semaphore_destroy(present_workers[i].start);
+         present_workers[i].start = NULL;
+         threads = i;
+         break;
+      }
+   }
+
+   present_threads = threads;
+}
+
+//Only rebuilds the lookup tables if the palette actually changed,
+//returns 1 if it did
+static int present_palette_update()
+{
+   const RvR_color *pal = RvR_palette();
+   if(pal==NULL)
+      return 0;
+   if(present_pal_valid&&memcmp(pal,present_pal,sizeof(present_pal))==0)
+      return 0;
+
+   present_pal_valid = 1;
+   memcpy(present_pal,pal,sizeof(present_pal));
+   memcpy(present_pal32,pal,sizeof(present_pal32));
+
+   if(present_pal_pairs==NULL)
+      return 1;
+
+   for(int i = 0;i<65536;i++)
+   {
+      RvR_color pair[2];
+      pair[0] = present_pal[i&255];
+      pair[1] = present_pal[i>>8];
+      memcpy(&present_pal_pairs[i],pair,sizeof(pair));
+   }
+
+   return 1;
+}
+
+static void present_expand(int x0, int x1, int y0, int y1)
+{
+#if PRESENT_AVX2
+   if(present_avx2)
+   {
+      present_expand_avx2(x0,x1,y0,y1);
+      return;
+   }
+#endif
+
+   present_expand_pairs(x0,x1,y0,y1);
+}
+
+//Expands two pixels at once, using a lookup table
+//indexed by both palette indices
+static void present_expand_pairs(int x0, int x1, int y0, int y1)
+{
+   for(int y = y0;y<y1;y++)
+   {
+      const uint8_t * restrict src = &present_src[y*RVR_XRES+x0];
+      uint8_t * restrict dst = &present_dst[(y-present_y)*present_stride+(x0-present_x)*4];
+
+      int x = 0;
+      for(;x<x1-x0-1;x+=2)
+         memcpy(&dst[x*4],&present_pal_pairs[src[x]|(src[x+1]<<8)],8);
+      for(;x<x1-x0;x++)
+         memcpy(&dst[x*4],&present_pal32[src[x]],4);
+   }
+}
+
+#if PRESENT_AVX2
+//Expands eight pixels at once, using a gather from the palette
+__attribute__((target("avx2"))) static void present_expand_avx2(int x0, int x1, int y0, int y1)
+{
+   for(int y = y0;y<y1;y++)
+   {
+      const uint8_t * restrict src = &present_src[y*RVR_XRES+x0];
+      uint8_t * restrict dst = &present_dst[(y-present_y)*present_stride+(x0-present_x)*4];
+
+      int x = 0;
+      for(;x<x1-x0-7;x+=8)
+      {
+         __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[x]));
+         __m256i color = _mm256_i32gather_epi32((const int *)present_pal32,index,4);
+         _mm256_storeu_si256((__m256i *)&dst[x*4],color);
+      }
+      for(;x<x1-x0;x++)
+         memcpy(&dst[x*4],&present_pal32[src[x]],4);
+   }
+}
+#endif
+
+static int present_worker(void *data)
+{
+   Present_worker *worker = data;
+
+   for(;;)
+   {
+      RvR_backend_semaphore_wait(worker->start);
+      present_rows(worker->y0,worker->y1);
+      RvR_backend_semaphore_post(present_done);
+   }
+
+   return 0;
+}
+
 static int get_gamepad_index(int which)
 {
    for(int i = 0;i<MAX_CONTROLLERS;i++)
@@ -566,4 +1245,84 @@ void RvR_backend_key_repeat(int repeat)
 {
    key_repeat = repeat;
 }
+
+void *RvR_backend_thread_create(int (*func)(void *data), void *data)
+{
+#if defined(__EMSCRIPTEN__)&&!defined(__EMSCRIPTEN_PTHREADS__)
+   return NULL;
+#else
+   RvR_malloc_threads_enable();
+
+   SDL_Thread *thread = SDL_CreateThread(func,"RvR_worker",data);
+   if(thread==NULL)
+      RvR_log_line("SDL_CreateThread ","%s\n",SDL_GetError());
+
+   return thread;
+#endif
+}
+
+void RvR_backend_thread_wait(void *thread)
+{
+   if(thread!=NULL)
+      SDL_WaitThread(thread,NULL);
+}
+
+int RvR_backend_cpu_count()
+{
+#if defined(__EMSCRIPTEN__)&&!defined(__EMSCRIPTEN_PTHREADS__)
+   return 1;
+#else
+   return RvR_max(1,SDL_GetCPUCount());
+#endif
+}
+
+void *RvR_backend_mutex_create()
+{
+   SDL_mutex *mutex = SDL_CreateMutex();
+   if(mutex==NULL)
+      RvR_log_line("SDL_CreateMutex ","%s\n",SDL_GetError());
+
+   return mutex;
+}
+
+void RvR_backend_mutex_lock(void *mutex)
+{
+   SDL_LockMutex(mutex);
+}
+
+void RvR_backend_mutex_unlock(void *mutex)
+{
+   SDL_UnlockMutex(mutex);
+}
+
+void RvR_backend_mutex_destroy(void *mutex)
+{
+   if(mutex!=NULL)
+      SDL_DestroyMutex(mutex);
+}
+
+void *RvR_backend_semaphore_create(int value)
+{
+   SDL_sem *sem = SDL_CreateSemaphore(value);
+   if(sem==NULL)
+      RvR_log_line("SDL_CreateSemaphore ","%s\n",SDL_GetError());
+
+   return sem;
+}
+
+void RvR_backend_semaphore_wait(void *sem)
+{
+   SDL_SemWait(sem);
+}
+
+void RvR_backend_semaphore_post(void *sem)
+{
+   SDL_SemPost(sem);
+}
+
+void RvR_backend_semaphore_destroy(void *sem)
+{
+   if(sem!=NULL)
+      SDL_DestroySemaphore(sem);
+}
 //-------------------------------------